@@ -0,0 +1,70 @@
+#pragma once
+
+#include <wayfire/config/config-manager.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * A binding which activates more than one option.
+ */
+struct binding_conflict_t
+{
+    /**
+     * The binding, in the format used in config files, for example
+     * "<super> KEY_E" or "swipe up 3".
+     */
+    std::string binding;
+
+    /** The full names (section/option) of the conflicting options, sorted. */
+    std::vector<std::string> options;
+
+    bool operator ==(const binding_conflict_t& other) const
+    {
+        return binding == other.binding && options == other.options;
+    }
+};
+
+/**
+ * Find all bindings which activate more than one option of the configuration.
+ *
+ * Options of type keybinding_t, buttonbinding_t, touchgesture_t and
+ * activatorbinding_t are checked against each other. Keybindings and
+ * buttonbindings conflict if they are equal. Touch gestures conflict if they
+ * match each other, so a gesture without a direction conflicts with gestures
+ * of the same type and finger count in any direction. Gestures without a
+ * direction cannot be written in config files, so their conflicts are
+ * reported for each direction in which they occur, for example as
+ * "swipe left 3" and "swipe right 3". Hotspots of activators conflict if they
+ * are on the same edges of the output.
+ *
+ * Disabled bindings (for example a keybinding set to "none") never conflict.
+ *
+ * The analysis uses the binding index of the config manager (see
+ * config_manager_t::get_options_for_binding()), so its cost is linear in the
+ * number of bindings.
+ *
+ * @return The conflicts, sorted by binding.
+ */
+std::vector<binding_conflict_t> find_binding_conflicts(
+    const config_manager_t& config);
+
+/**
+ * Find the conflicts which involve the option with the given full name
+ * (section/option), see find_binding_conflicts(const config_manager_t&).
+ *
+ * Only the bindings of the option are checked, so this is cheap enough to be
+ * done after each change of the option, for example while the user is
+ * editing it.
+ *
+ * @return The conflicts, sorted by binding. Empty if the option doesn't exist
+ *   or is not a binding option.
+ */
+std::vector<binding_conflict_t> find_binding_conflicts(
+    const config_manager_t& config, std::string_view option_name);
+}
+}
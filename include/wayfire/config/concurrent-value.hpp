@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * A value which is written by one thread at a time (the writer) and which can
+ * be read concurrently from any number of threads without taking a lock.
+ *
+ * Each written value is published as a new immutable snapshot. Readers copy
+ * the current snapshot, so they always see a value which was fully written,
+ * never a partially updated one.
+ *
+ * Readers register in one of two counters, chosen by the parity of an epoch.
+ * When a new snapshot is stored, the writer advances the epoch and waits
+ * until the readers of the previous epoch, which may still use the replaced
+ * snapshot, are done. Then the replaced snapshot is freed, so at most two
+ * snapshots exist at any time, no matter how often the value is read.
+ *
+ * store() must not be called concurrently with another store(), typically it
+ * is called only by the thread which modifies the value. load() may be called
+ * from any thread.
+ */
+template<class Type>
+class concurrent_value_t
+{
+  public:
+    concurrent_value_t(const Type& initial) :
+        current(new Type(initial))
+    {}
+
+    ~concurrent_value_t()
+    {
+        delete current.load();
+    }
+
+    concurrent_value_t(const concurrent_value_t& other) = delete;
+    concurrent_value_t& operator =(const concurrent_value_t& other) = delete;
+
+    /** @return A copy of the last stored value. */
+    Type load() const
+    {
+        while (true)
+        {
+            size_t observed = epoch.load();
+            auto& counter   = readers[observed & 1];
+            ++counter;
+
+            // If the epoch changed in the meantime, the writer may not wait
+            // for this counter anymore, so register again.
+            if (epoch.load() == observed)
+            {
+                Type value = *current.load();
+                --counter;
+                return value;
+            }
+
+            --counter;
+        }
+    }
+
+    /**
+     * Publish a new value. Readers which are in the middle of load() will
+     * still get the previous value.
+     *
+     * Waits until the reads which may still use the previous snapshot are
+     * done, which takes at most as long as copying the value.
+     */
+    void store(const Type& value)
+    {
+        auto *previous = current.exchange(new Type(value));
+
+        // Readers which start from now on see the new snapshot and register in
+        // the other counter.
+        size_t old_epoch = epoch.fetch_add(1);
+        while (readers[old_epoch & 1].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        delete previous;
+    }
+
+  private:
+    std::atomic<Type*> current;
+    std::atomic<size_t> epoch{0};
+
+    // Number of readers in load(), by the parity of the epoch they observed
+    mutable std::atomic<size_t> readers[2] = {{0}, {0}};
+};
+}
+}
@@ -1,14 +1,44 @@
 #pragma once
 
 #include <wayfire/config/section.hpp>
+#include <wayfire/config/types.hpp>
+#include <cstdint>
+#include <functional>
+#include <string_view>
 
 namespace wf
 {
 namespace config
 {
+/**
+ * A pre-resolved reference to an option in a config manager, see
+ * config_manager_t::get_option_handle().
+ */
+struct option_handle_t
+{
+    static constexpr uint32_t INVALID_ID = UINT32_MAX;
+
+    /** The index of the option in the table of handles of the config manager. */
+    uint32_t id = INVALID_ID;
+
+    bool is_valid() const
+    {
+        return id != INVALID_ID;
+    }
+};
+
 /**
  * Manages the whole configuration of a program.
  * The configuration consists of a list of sections with their options.
+ *
+ * The config manager belongs to the thread which modifies it, the owning
+ * thread. get_section(), get_option(std::string_view), get_all_sections() and
+ * for_each_section() may also be called from other threads, as long as the
+ * config manager is not modified at the same time. They build lazy sections
+ * under a lock, on the calling thread. All other functions, including the
+ * const ones, which keep caches, must only be called on the owning thread.
+ * The values of the options are not protected by this, see
+ * option_t::get_value_concurrent().
  */
 class config_manager_t
 {
@@ -22,17 +52,44 @@ class config_manager_t
      */
     void merge_section(std::shared_ptr<section_t> section);
 
+    using section_builder_t = std::function<std::shared_ptr<section_t>()>;
+
+    /**
+     * Add a section which is built only when it is first needed, that is, when
+     * it is accessed with get_section(), get_option() or get_all_sections(),
+     * or when another section with the same name is merged.
+     *
+     * The built section is merged as if it had been added with
+     * merge_section() at that point. Multiple builders for the same name are
+     * run in the order they were added.
+     *
+     * @param name The name of the section which @builder returns.
+     * @param builder Builds the section, must return non-null.
+     */
+    void merge_lazy_section(const std::string& name, section_builder_t builder);
+
     /**
      * Find the configuration section with the given name.
      * @return nullptr if the section doesn't exist.
      */
-    std::shared_ptr<section_t> get_section(const std::string& name) const;
+    std::shared_ptr<section_t> get_section(std::string_view name) const;
 
     /**
      * @return A list of all sections currently in the config manager.
+     *   Lazy sections are built first.
      */
     std::vector<std::shared_ptr<section_t>> get_all_sections() const;
 
+    /**
+     * Call @callback for each section, in the same order as get_all_sections(),
+     * but without creating a list of the sections. Lazy sections are built
+     * first.
+     *
+     * @callback must not add sections to the config manager.
+     */
+    void for_each_section(
+        const std::function<void(const std::shared_ptr<section_t>&)>& callback) const;
+
     /**
      * Get the option with the given name.
      * The name consists of the name of the option section, followed by a '/',
@@ -41,25 +98,96 @@ class config_manager_t
      *
      * If the option doesn't exist, nullptr is returned.
      */
-    std::shared_ptr<option_base_t> get_option(const std::string& name) const;
+    std::shared_ptr<option_base_t> get_option(std::string_view name) const;
 
     /**
      * Get the option with the given name. Same semantics as
-     * get_option(std::string), but casts the result to the appropriate type.
+     * get_option(std::string_view), but casts the result to the appropriate
+     * type.
      */
     template<class T>
-    std::shared_ptr<option_t<T>> get_option(const std::string& name) const
+    std::shared_ptr<option_t<T>> get_option(std::string_view name) const
     {
         return std::dynamic_pointer_cast<option_t<T>>(get_option(name));
     }
 
+    /**
+     * Resolve the option with the given name (see get_option()) to a handle,
+     * which gives access to the option without looking up its name again.
+     *
+     * The handle stays valid as long as the config manager exists. If the
+     * option is replaced in its section, for example because a section with
+     * the same option was merged or the option was registered again, the
+     * handle refers to the new option. Resolving the same name again returns
+     * the same handle.
+     *
+     * Must only be called on the owning thread.
+     *
+     * @return The handle, or an invalid handle if the option doesn't exist.
+     */
+    option_handle_t get_option_handle(std::string_view name) const;
+
+    /**
+     * Get the option which @handle refers to, in constant time.
+     * Must only be called on the owning thread.
+     *
+     * @return The option, or nullptr if the handle is invalid or the option
+     *   has been removed from its section.
+     */
+    std::shared_ptr<option_base_t> get_option(option_handle_t handle) const;
+
+    /**
+     * Same as get_option(option_handle_t), but casts the result to the
+     * appropriate type.
+     */
+    template<class T>
+    std::shared_ptr<option_t<T>> get_option(option_handle_t handle) const
+    {
+        return std::dynamic_pointer_cast<option_t<T>>(get_option(handle));
+    }
+
+    /**
+     * Find the options which are activated by the given keybinding, that is,
+     * keybinding options with the same value and activator options which
+     * have a match for it.
+     *
+     * The lookup uses an index of all binding options, which is built on the
+     * first call and then kept up to date with the configuration. Changes of
+     * option values which happen in a notification batch are reflected only
+     * after the batch has ended. The index is not shared between threads, so
+     * this must only be called on the owning thread, and once it has been
+     * called, options with binding types must only be modified on the owning
+     * thread too. Lazy sections are built only if they may contain binding
+     * options, which is the case for the sections from XML files that declare
+     * options of a binding type, and for all sections added with
+     * merge_lazy_section().
+     *
+     * @return The matching options, in no particular order.
+     */
+    std::vector<std::shared_ptr<option_base_t>> get_options_for_binding(
+        const keybinding_t& key) const;
+
+    /**
+     * Same as get_options_for_binding(const keybinding_t&), for buttonbinding
+     * options and activator options.
+     */
+    std::vector<std::shared_ptr<option_base_t>> get_options_for_binding(
+        const buttonbinding_t& button) const;
+
+    /**
+     * Same as get_options_for_binding(const keybinding_t&), for touch gesture
+     * options and activator options. A gesture without a direction matches
+     * gestures with any direction, see touchgesture_t::operator ==.
+     */
+    std::vector<std::shared_ptr<option_base_t>> get_options_for_binding(
+        const touchgesture_t& gesture) const;
+
     config_manager_t();
     config_manager_t(config_manager_t&& other);
     config_manager_t& operator =(config_manager_t&& other);
 
     virtual ~config_manager_t();
 
-  private:
     struct impl;
     std::unique_ptr<impl> priv;
 };
@@ -1,11 +1,33 @@
 #pragma once
 
 #include <wayfire/config/config-manager.hpp>
+#include <ostream>
 
 namespace wf
 {
 namespace config
 {
+/**
+ * Describes the effect of reloading a configuration file on a config manager.
+ */
+struct config_change_set_t
+{
+    struct entry_t
+    {
+        std::shared_ptr<section_t> section;
+        std::shared_ptr<option_base_t> option;
+    };
+
+    /** Options whose value or lock state changed, including new options. */
+    std::vector<entry_t> changed;
+    /** Options which were not set in the config file before but are now. */
+    std::vector<entry_t> added;
+    /** Options which were set in the config file before but are not anymore. */
+    std::vector<entry_t> removed;
+    /** Sections which were reloaded, i.e not skipped as unchanged. */
+    std::vector<std::shared_ptr<section_t>> sections;
+};
+
 /**
  * Parse a multi-line string as a configuration file.
  * The string consists of multiple sections of the following format:
@@ -28,6 +50,11 @@ namespace config
  * in @manager. Each line which contains errors is reported on the log and then
  * ignored.
  *
+ * Options which are not present in the string are reset to their default
+ * value, unless they are locked. Reloading is incremental: a section is skipped
+ * entirely if its lines are the same as in the previous load, and its options,
+ * their values and their lock state have not been changed since then.
+ *
  * @param manager The config manager to update.
  * @param source The multi-line string representing the source
  * @param source_name The name to be used when reporting errors to the log
@@ -35,6 +62,14 @@ namespace config
 void load_configuration_options_from_string(config_manager_t& manager,
     const std::string& source, const std::string& source_name = "");
 
+/**
+ * Same as load_configuration_options_from_string(), but additionally appends
+ * the changes to the configuration which were made to @changes.
+ */
+void load_configuration_options_from_string(config_manager_t& manager,
+    const std::string& source, const std::string& source_name,
+    config_change_set_t& changes);
+
 /**
  * Create a string which conttains all the sections and the options in the given
  * configuration manager. The format is the same one as the one described in
@@ -45,6 +80,13 @@ void load_configuration_options_from_string(config_manager_t& manager,
 std::string save_configuration_options_to_string(
     const config_manager_t& manager);
 
+/**
+ * Write all the sections and the options in the given configuration manager to
+ * the given stream, in the same format as save_configuration_options_to_string().
+ */
+void save_configuration_options_to_stream(const config_manager_t& manager,
+    std::ostream& out);
+
 /**
  * Load the options from the given config file.
  *
@@ -53,6 +95,9 @@ std::string save_configuration_options_to_string(
  * a shared lock on the config file, and does not do anything if another process
  * already holds an exclusive lock.
  *
+ * The file is read into memory while the shared lock is held, and the lock is
+ * released before parsing.
+ *
  * @param manager The config manager to update.
  * @param file The config file to use.
  *
@@ -62,6 +107,13 @@ std::string save_configuration_options_to_string(
 bool load_configuration_options_from_file(config_manager_t& manager,
     const std::string& file);
 
+/**
+ * Same as load_configuration_options_from_file(), but additionally appends
+ * the changes to the configuration which were made to @changes.
+ */
+bool load_configuration_options_from_file(config_manager_t& manager,
+    const std::string& file, config_change_set_t& changes);
+
 /**
  * Writes the options in the given configuration to the given file.
  * It is roughly equivalent to calling serialize_configuration_manager() and
@@ -71,13 +123,50 @@ bool load_configuration_options_from_file(config_manager_t& manager,
 void save_configuration_to_file(const config_manager_t& manager,
     const std::string& file);
 
+enum save_flags_t
+{
+    /**
+     * Write the configuration to a temporary file in the same directory, sync
+     * it to disk and then rename it over the config file. Readers never see a
+     * partially written file, and the exclusive lock on the config file is
+     * held only while renaming.
+     *
+     * If the config file is a symlink, for example into a repository of a
+     * dotfile manager, its target is replaced and the symlink is kept. The
+     * permissions of the config file are kept, and so are its owner and group
+     * if the process is allowed to set them, typically when running as root.
+     * Other metadata, like extended attributes and hard links to the file, is
+     * not kept.
+     */
+    SAVE_ATOMIC          = (1 << 0),
+    /**
+     * Update the existing config file in place instead of regenerating it:
+     * lines of options whose value has changed are replaced, new options are
+     * added at the end of their section and entries of removed compound
+     * options are deleted. Comments, ordering and formatting of all other
+     * lines are kept. Options which are not in the file yet are only written
+     * if they do not have their default value.
+     *
+     * If nothing has changed, the file is not written at all. If the file does
+     * not exist, the whole configuration is written as usual.
+     */
+    SAVE_PRESERVE_FORMAT = (1 << 1),
+};
+
+/**
+ * Same as save_configuration_to_file(), but with the behavior adjusted by
+ * @flags, which is a bitmask of save_flags_t values.
+ */
+void save_configuration_to_file(const config_manager_t& manager,
+    const std::string& file, uint32_t flags);
+
 /**
  * Build a configuration for the given program from the files on the filesystem.
  *
  * The following steps are performed:
  * 1. Each of the XML files in each of @xmldirs are read, and options there
- *   are used to build a configuration. Note that the XML nodes which are
- *   allocated will not be freed.
+ *   are used to build a configuration. Only the owned metadata of the XML
+ *   elements is kept, see build_options_t::retain_xml_nodes.
  * 2. The @sysconf file is used to overwrite default values from XML files.
  * 3. The @userconf file is used to determine the actual values of options.
  *
@@ -86,5 +175,59 @@ void save_configuration_to_file(const config_manager_t& manager,
  */
 config_manager_t build_configuration(const std::vector<std::string>& xmldirs,
     const std::string& sysconf, const std::string& userconf);
+
+/**
+ * Options which control how build_configuration() builds the configuration.
+ */
+struct build_options_t
+{
+    /**
+     * Path of a file used to cache the option schemas declared in the XML
+     * files. XML files whose size and modification time have not changed since
+     * the cache was written are not parsed again. Empty to disable the cache.
+     *
+     * Note that sections and options which are loaded from the cache have no
+     * XML node, see get_option_xml_node() and get_section_xml_node(). Their
+     * metadata is still available, see get_option_metadata().
+     */
+    std::string schema_cache;
+
+    /**
+     * Whether to keep the parsed XML documents in memory, so that
+     * get_option_xml_node() and get_section_xml_node() work for the options and
+     * sections declared in them. The documents are then never freed, since
+     * the options and sections point into them.
+     *
+     * By default, the XML files are read with a streaming parser which never
+     * builds the documents, and only the owned metadata is kept, see
+     * get_option_metadata() and get_section_metadata(). This saves the memory
+     * and the time needed to build and keep the documents.
+     */
+    bool retain_xml_nodes = false;
+
+    /**
+     * Number of threads used to load the XML files, or 0 to use one thread per
+     * CPU core. The resulting configuration is the same regardless of the
+     * number of threads, only the order of the messages in the log may differ.
+     */
+    unsigned int xml_threads = 1;
+
+    /**
+     * Whether the sections declared in the XML files should be built only when
+     * they are first needed, see config_manager_t::merge_lazy_section().
+     *
+     * Sections which are mentioned in the config files are built right away.
+     * All other sections are built when they are accessed, which saves time
+     * and memory if many plugins are installed but only few are used.
+     */
+    bool lazy_sections = false;
+};
+
+/**
+ * Same as build_configuration(), but with the behavior adjusted by @options.
+ */
+config_manager_t build_configuration(const std::vector<std::string>& xmldirs,
+    const std::string& sysconf, const std::string& userconf,
+    const build_options_t& options);
 }
 }
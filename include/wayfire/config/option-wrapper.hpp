@@ -94,13 +94,25 @@ class base_option_wrapper_t
         }
     }
 
+    /**
+     * The type returned by value(). Values of compound options are converted
+     * on each access, values of other options are returned by reference.
+     */
+    using value_ref_t = std::conditional_t<is_std_vector<Type>::value,
+        Type, const Type&>;
+
     /** Implicitly convertible to the value of the option */
-    operator Type() const
+    operator value_ref_t() const
     {
         return this->value();
     }
 
-    Type value() const
+    /**
+     * @return The value of the option. For options which are not compound
+     *   options, this is a reference to the value stored in the option, which
+     *   is valid until the value changes.
+     */
+    value_ref_t value() const
     {
         if constexpr (is_std_vector<Type>::value)
         {
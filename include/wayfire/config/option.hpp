@@ -1,6 +1,7 @@
 #pragma once
 
 #include <wayfire/config/option-types.hpp>
+#include <wayfire/config/concurrent-value.hpp>
 #include <functional>
 #include <limits>
 
@@ -10,6 +11,8 @@ namespace wf
 {
 namespace config
 {
+class update_dispatcher_t;
+
 /**
  * A base class for all option types.
  */
@@ -62,6 +65,31 @@ class option_base_t
      */
     void add_updated_handler(updated_callback_t *callback);
 
+    /**
+     * Register a new callback to execute when the option value changes, which
+     * is run by @dispatcher instead of the thread which changed the value.
+     *
+     * Updates which happen before the dispatcher gets to run the callback are
+     * coalesced, so the callback runs once for them. If the callback is
+     * unregistered in the meantime, it is not run at all.
+     *
+     * The threads involved are:
+     * - The option is modified by one thread at a time, for example a worker
+     *   thread. Registering and unregistering handlers must not happen
+     *   concurrently with changes of the option.
+     * - The callback runs on the thread which calls dispatcher.dispatch().
+     *   Since the option may be modified again while the callback runs, the
+     *   callback must read the value with get_value_concurrent(), so
+     *   enable_concurrent_reads() must have been called on the option.
+     * - A callback which is unregistered on another thread than the one
+     *   running the dispatcher may still be running when
+     *   rem_updated_handler() returns.
+     *
+     * The dispatcher must outlive the registration.
+     */
+    void add_updated_handler(updated_callback_t *callback,
+        update_dispatcher_t& dispatcher);
+
     /**
      * Unregister a callback to execute when the option value changes.
      * If the same callback has been registered multiple times, this unregister
@@ -95,6 +123,12 @@ class option_base_t
     /** Notify all watchers */
     void notify_updated() const;
 
+    /**
+     * Record that the default value has changed. Watchers are not notified,
+     * but reloads of the configuration do not skip the option's section.
+     */
+    void default_value_changed();
+
     /** Initialize a cloned version of this option. */
     void init_clone(option_base_t& clone) const;
 };
@@ -194,6 +228,11 @@ class option_t : public option_base_t,
             result->maximum = this->maximum;
         }
 
+        if (snapshot)
+        {
+            result->enable_concurrent_reads();
+        }
+
         init_clone(*result);
         return result;
     }
@@ -231,7 +270,12 @@ class option_t : public option_base_t,
         auto parsed = option_type::from_string<Type>(defvalue);
         if (parsed)
         {
-            this->default_value = parsed.value();
+            if (!(this->default_value == parsed.value()))
+            {
+                this->default_value = parsed.value();
+                this->default_value_changed();
+            }
+
             return true;
         }
 
@@ -249,16 +293,58 @@ class option_t : public option_base_t,
         if (!(this->value == real_value))
         {
             this->value = real_value;
+            publish_value();
             this->notify_updated();
         }
     }
 
-    Type get_value() const
+    /**
+     * @return The current value of the option. The reference is valid until
+     *   the value of the option changes, so it should not be stored.
+     */
+    const Type& get_value() const
     {
         return value;
     }
 
-    Type get_default_value() const
+    /**
+     * Allow the option value to be read from other threads with
+     * get_value_concurrent(). Must be called before the option is shared with
+     * other threads.
+     *
+     * The option must still be modified by only one thread at a time. This is
+     * usually the thread which owns the option, but it may also be a worker
+     * thread, see add_updated_handler(updated_callback_t*, update_dispatcher_t&).
+     * The direct updated handlers are called on the thread which modifies the
+     * option.
+     */
+    void enable_concurrent_reads()
+    {
+        if (!snapshot)
+        {
+            snapshot = std::make_unique<concurrent_value_t<Type>>(value);
+        }
+    }
+
+    /**
+     * Get the value of the option without synchronizing with the owning
+     * thread. Concurrent changes of the value are atomic, that is, the result
+     * is either the old or the new value of the option.
+     *
+     * May be called from any thread. Requires enable_concurrent_reads(),
+     * otherwise this is the same as get_value() and may be called only on the
+     * thread which modifies the option.
+     */
+    Type get_value_concurrent() const
+    {
+        return snapshot ? snapshot->load() : value;
+    }
+
+    /**
+     * @return The default value of the option. The reference is valid until
+     *   the default value changes.
+     */
+    const Type& get_default_value() const
     {
         return default_value;
     }
@@ -284,6 +370,7 @@ class option_t : public option_base_t,
     {
         this->minimum = {min};
         this->value   = this->closest_valid_value(this->value);
+        publish_value();
     }
 
     /**
@@ -296,11 +383,67 @@ class option_t : public option_base_t,
     {
         this->maximum = {max};
         this->value   = this->closest_valid_value(this->value);
+        publish_value();
     }
 
   protected:
     Type default_value; /* default value */
     Type value; /* current value */
+
+  private:
+    /* Snapshot of the value for concurrent readers, if enabled */
+    std::unique_ptr<concurrent_value_t<Type>> snapshot;
+
+    void publish_value()
+    {
+        if (snapshot)
+        {
+            snapshot->store(value);
+        }
+    }
+};
+
+/**
+ * Start a notification batch on the calling thread. Until the batch is ended,
+ * update notifications of options changed on the calling thread are not
+ * delivered. Instead, they are coalesced, so that each option which was
+ * changed notifies its handlers exactly once, after the outermost batch has
+ * ended.
+ *
+ * The scope of a batch is the calling thread, not a config manager: it
+ * applies to all options changed on the thread, and it must be ended on the
+ * same thread. Batches may be nested. Loading the configuration from a string
+ * or a file automatically happens in a batch.
+ *
+ * An option which is destroyed while a batch holds a notification for it, on
+ * any thread, is not notified. Prefer notification_batch_t, which also ends
+ * the batch if an exception is thrown.
+ */
+void begin_notification_batch();
+
+/**
+ * End a batch started with begin_notification_batch() on the calling thread.
+ * If this is the outermost batch, the deferred notifications are delivered.
+ *
+ * If an update handler throws, the options which are left still notify their
+ * handlers, and then the first exception is rethrown.
+ */
+void end_notification_batch();
+
+/**
+ * A notification batch (see begin_notification_batch()) which lasts as long as
+ * the notification_batch_t object. The batch is ended when the object is
+ * destroyed, also when the scope is left with an exception. Exceptions thrown
+ * by update handlers at that point are logged and not propagated.
+ */
+class notification_batch_t
+{
+  public:
+    notification_batch_t();
+    ~notification_batch_t();
+
+    notification_batch_t(const notification_batch_t& other) = delete;
+    notification_batch_t& operator =(const notification_batch_t& other) = delete;
 };
 }
 }
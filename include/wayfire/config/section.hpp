@@ -1,6 +1,8 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <string_view>
 #include <vector>
 #include <wayfire/config/option.hpp>
 
@@ -34,13 +36,13 @@ class section_t
      * @return The option with the given name, or nullptr if no such option
      * has been added yet.
      */
-    std::shared_ptr<option_base_t> get_option_or(const std::string& name);
+    std::shared_ptr<option_base_t> get_option_or(std::string_view name);
 
     /**
      * @return The option with the given name.
      * @throws std::invalid_argument if the option hasn't been added.
      */
-    std::shared_ptr<option_base_t> get_option(const std::string& name);
+    std::shared_ptr<option_base_t> get_option(std::string_view name);
 
     using option_list_t = std::vector<std::shared_ptr<option_base_t>>;
     /**
@@ -48,6 +50,15 @@ class section_t
      */
     option_list_t get_registered_options() const;
 
+    /**
+     * Call @callback for each option in this config section, in the same order
+     * as get_registered_options(), but without creating a list of the options.
+     *
+     * @callback must not register or unregister options in this section.
+     */
+    void for_each_option(
+        const std::function<void(const std::shared_ptr<option_base_t>&)>& callback) const;
+
     /**
      * Register a new option, which means it is marked as belonging to this
      * section and it will show up in the list of get_registered_options().
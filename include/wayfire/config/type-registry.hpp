@@ -0,0 +1,139 @@
+#pragma once
+/**
+ * This file contains the registry of option types which can be used in XML
+ * files, for example <option name="..." type="int">.
+ */
+
+#include <wayfire/config/compound-option.hpp>
+#include <functional>
+#include <type_traits>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * Describes how options of a type are created from their declaration in an
+ * XML file.
+ */
+struct option_type_info_t
+{
+    /**
+     * Create an option with the given name and default value.
+     * @return nullptr if the default value is invalid.
+     */
+    std::function<std::shared_ptr<option_base_t>(const std::string& name,
+        const std::string& default_value)> create_option;
+
+    /**
+     * Set the minimum/maximum of an option returned by create_option.
+     * @return false if the value is invalid.
+     *
+     * Empty if the type does not support bounds, in which case <min> and <max>
+     * in the XML file are ignored.
+     */
+    std::function<bool(option_base_t& option, const std::string& value)>
+    set_minimum, set_maximum;
+
+    /**
+     * Create an entry of a dynamic-list option with the given prefix, name and
+     * default value. Empty if the type can't be used in dynamic lists.
+     */
+    std::function<std::unique_ptr<compound_option_entry_base_t>(
+        const std::string& prefix, const std::string& name,
+        const std::optional<std::string>& default_value)> create_entry;
+};
+
+/**
+ * Create the description of an option type which is represented by
+ * option_t<Type>. option_type::from_string() and option_type::to_string() must
+ * be specialized for @Type.
+ *
+ * Arithmetic types except bool support bounds.
+ */
+template<class Type>
+option_type_info_t make_option_type_info()
+{
+    option_type_info_t info;
+    info.create_option = [] (const std::string& name, const std::string& default_value)
+    -> std::shared_ptr<option_base_t>
+    {
+        auto value = option_type::from_string<Type>(default_value);
+        if (!value)
+        {
+            return nullptr;
+        }
+
+        return std::make_shared<option_t<Type>>(name, value.value());
+    };
+
+    if constexpr (std::is_arithmetic<Type>::value && !std::is_same<Type, bool>::value)
+    {
+        info.set_minimum = [] (option_base_t& option, const std::string& str)
+        {
+            auto value = option_type::from_string<Type>(str);
+            if (value)
+            {
+                static_cast<option_t<Type>&>(option).set_minimum(value.value());
+            }
+
+            return value.has_value();
+        };
+
+        info.set_maximum = [] (option_base_t& option, const std::string& str)
+        {
+            auto value = option_type::from_string<Type>(str);
+            if (value)
+            {
+                static_cast<option_t<Type>&>(option).set_maximum(value.value());
+            }
+
+            return value.has_value();
+        };
+    }
+
+    info.create_entry = [] (const std::string& prefix, const std::string& name,
+                            const std::optional<std::string>& default_value)
+    -> std::unique_ptr<compound_option_entry_base_t>
+    {
+        return std::make_unique<compound_option_entry_t<Type>>(prefix, name,
+            default_value);
+    };
+
+    return info;
+}
+
+/**
+ * Register a type which can be used for options and dynamic-list entries in
+ * XML files, replacing any previous type with the same name. The built-in
+ * types (int, double, bool, string, key, button, gesture, color, activator,
+ * output::mode, output::position and animation) are registered from the
+ * start. They may be replaced as well, for example to remove the support for
+ * bounds of a type, which is logged.
+ *
+ * The name "dynamic-list" is reserved for compound options, registering a
+ * type with this name fails with an error in the log.
+ *
+ * Types should be registered before XML files are loaded. The registry is not
+ * protected against registering types while XML files are being loaded.
+ */
+void register_option_type(const std::string& name, option_type_info_t info);
+
+/**
+ * Register @Type under the given name, see make_option_type_info().
+ */
+template<class Type>
+void register_option_type(const std::string& name)
+{
+    register_option_type(name, make_option_type_info<Type>());
+}
+
+/**
+ * Find a registered option type.
+ *
+ * @return The description of the type, or nullptr if there is no type with
+ *   the given name.
+ */
+const option_type_info_t *find_option_type(const std::string& name);
+}
+}
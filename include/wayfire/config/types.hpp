@@ -444,6 +444,15 @@ struct activatorbinding_t
      */
     const std::vector<wf::hotspot_binding_t>& get_hotspots() const;
 
+    /** @return A list of all keybindings which activate this binding. */
+    const std::vector<wf::keybinding_t>& get_keys() const;
+
+    /** @return A list of all buttonbindings which activate this binding. */
+    const std::vector<wf::buttonbinding_t>& get_buttons() const;
+
+    /** @return A list of all touch gestures which activate this binding. */
+    const std::vector<wf::touchgesture_t>& get_gestures() const;
+
     /**
      * @return A list of all unknown bindings which activate this binding.
      */
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * Runs callbacks on the thread which owns the dispatcher, typically the thread
+ * running the event loop of the program.
+ *
+ * Callbacks can be queued from any thread with post(). The dispatcher provides
+ * a file descriptor (an eventfd) which becomes readable when callbacks are
+ * queued, and which can be added to the event loop of the program. When it is
+ * readable, dispatch() should be called on the owning thread.
+ *
+ * Update handlers of options can be bound to a dispatcher, see
+ * option_base_t::add_updated_handler(), so that options can be modified from
+ * a worker thread while their handlers run on the owning thread. The handlers
+ * then read the values with option_t::get_value_concurrent().
+ */
+class update_dispatcher_t
+{
+  public:
+    update_dispatcher_t();
+    update_dispatcher_t(const update_dispatcher_t& other) = delete;
+    update_dispatcher_t& operator =(const update_dispatcher_t& other) = delete;
+
+    /** Callbacks which have not been dispatched yet are dropped. */
+    ~update_dispatcher_t();
+
+    /**
+     * @return A file descriptor which becomes readable when dispatch() should
+     *   be called, or -1 if the eventfd could not be created. In the latter
+     *   case, dispatch() has to be called periodically instead.
+     */
+    int get_fd() const;
+
+    /**
+     * Queue a callback to be run by the next dispatch(). Can be called from any
+     * thread, and does not take a lock.
+     */
+    void post(std::function<void()> callback);
+
+    /**
+     * Run all queued callbacks in the order they were posted. Does not block.
+     * Callbacks posted while dispatching are run by the next dispatch().
+     */
+    void dispatch();
+
+    struct impl;
+    std::unique_ptr<impl> priv;
+};
+}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <wayfire/config/file.hpp>
+#include <functional>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * Watches the configuration files of a program with inotify and reloads them
+ * when they change.
+ *
+ * The watcher does not spawn any threads. Instead, it provides a file
+ * descriptor which becomes readable whenever there is work to do, and which
+ * can be added to the event loop of the program. When it is readable,
+ * dispatch() should be called.
+ *
+ * Bursts of changes are debounced: the files are reloaded only after no change
+ * has been observed for a given interval. If a writer holds an exclusive lock
+ * on the config file at that point, the reload is retried after another
+ * interval, so that the file is read only once the writer is done.
+ */
+class config_watcher_t
+{
+  public:
+    enum watched_files_t
+    {
+        /** The user config file has changed. */
+        WATCH_USERCONF = (1 << 0),
+        /** The system config file has changed. */
+        WATCH_SYSCONF  = (1 << 1),
+        /** An XML file in one of the XML directories has changed. */
+        WATCH_XML      = (1 << 2),
+    };
+
+    /**
+     * Called after the changed files have been processed.
+     *
+     * @param changed_files A bitmask of watched_files_t values.
+     * @param changes The changes made to the configuration by reloading the
+     *   user config file. Options whose value changed only because of a new
+     *   default value in the system config file are not included.
+     */
+    using reload_callback_t = std::function<void (uint32_t changed_files,
+        const config_change_set_t& changes)>;
+
+    /**
+     * Create a new watcher for a configuration created with
+     * build_configuration() from the same files.
+     *
+     * When the user config file changes, it is reloaded with
+     * load_configuration_options_from_file(). When the system config file
+     * changes, the new default values are applied and then the user config
+     * file is reloaded. Note that defaults which were removed from the system
+     * config file, as well as changes to the XML files, cannot be applied to
+     * the existing configuration. Instead, they are reported to the callback,
+     * which may then rebuild the configuration.
+     *
+     * The config manager must outlive the watcher.
+     *
+     * @param debounce_ms The time to wait after the last change before the
+     *   files are reloaded, in milliseconds.
+     */
+    config_watcher_t(config_manager_t& manager,
+        const std::vector<std::string>& xmldirs, const std::string& sysconf,
+        const std::string& userconf, int debounce_ms = 50);
+
+    config_watcher_t(const config_watcher_t& other) = delete;
+    config_watcher_t& operator =(const config_watcher_t& other) = delete;
+    ~config_watcher_t();
+
+    /**
+     * Set the callback to be called after each reload.
+     */
+    void set_reload_callback(reload_callback_t callback);
+
+    /**
+     * @return A file descriptor which becomes readable when dispatch() should
+     *   be called, or -1 if the watcher could not be initialized.
+     */
+    int get_fd() const;
+
+    /**
+     * Process pending file system events and reload the configuration if the
+     * debounce interval has passed. Does not block.
+     */
+    void dispatch();
+
+  private:
+    struct impl;
+    std::unique_ptr<impl> priv;
+};
+}
+}
@@ -9,6 +9,8 @@
 
 #include <wayfire/config/option.hpp>
 #include <wayfire/config/section.hpp>
+#include <optional>
+#include <vector>
 
 namespace wf
 {
@@ -16,6 +18,29 @@ namespace config
 {
 namespace xml
 {
+/**
+ * An owned copy of an XML element, with its attributes, text and child
+ * elements. It is used to keep the metadata declared in XML files (labels,
+ * hints, entries, etc.) available after the XML documents have been freed.
+ */
+struct metadata_node_t
+{
+    /** The name of the element. */
+    std::string name;
+    /** The attributes of the element, in document order. */
+    std::vector<std::pair<std::string, std::string>> attributes;
+    /** The text directly contained in the element. */
+    std::string text;
+    /** The child elements, in document order. */
+    std::vector<metadata_node_t> children;
+
+    /** @return The value of the given attribute, if it is present. */
+    std::optional<std::string> get_attribute(const std::string& attribute) const;
+
+    /** @return The first child element with the given name, or nullptr. */
+    const metadata_node_t *get_child(const std::string& child) const;
+};
+
 /**
  * Create a new option from the given data in the xmlNode.
  * Errors are printed to the log (see wayfire/util/log.hpp).
@@ -55,6 +80,8 @@ std::shared_ptr<wf::config::section_t> create_section_from_xml_node(xmlNodePtr n
  * create_option_from_xml_node.
  *
  * @return The xmlNodePtr or NULL if the option wasn't created from an xml node.
+ *   Options created by build_configuration() have an XML node only if
+ *   build_options_t::retain_xml_nodes is set.
  */
 xmlNodePtr get_option_xml_node(
     std::shared_ptr<wf::config::option_base_t> option);
@@ -64,9 +91,30 @@ xmlNodePtr get_option_xml_node(
  * create_section_from_xml_node.
  *
  * @return The xmlNodePtr or NULL if the section wasn't created from an xml
- *   node.
+ *   node, see get_option_xml_node().
  */
 xmlNodePtr get_section_xml_node(std::shared_ptr<wf::config::section_t> section);
+
+/**
+ * Get the metadata of the XML element which declared @option.
+ *
+ * Unlike get_option_xml_node(), the metadata is available even if the XML
+ * nodes have not been retained, see build_options_t. If the XML node is
+ * available, the metadata is extracted from it on the first call.
+ *
+ * @return The metadata or nullptr if the option wasn't declared in XML.
+ */
+std::shared_ptr<const metadata_node_t> get_option_metadata(
+    std::shared_ptr<wf::config::option_base_t> option);
+
+/**
+ * Get the metadata of the XML element which declared @section, including the
+ * elements of all options in it.
+ *
+ * @return The metadata or nullptr if the section wasn't declared in XML.
+ */
+std::shared_ptr<const metadata_node_t> get_section_metadata(
+    std::shared_ptr<wf::config::section_t> section);
 }
 }
 }
@@ -0,0 +1,21 @@
+#include <wayfire/config/binding-conflicts.hpp>
+
+#include "config-manager-impl.hpp"
+
+std::vector<wf::config::binding_conflict_t> wf::config::find_binding_conflicts(
+    const config_manager_t& config)
+{
+    return config.priv->get_bindings().find_conflicts();
+}
+
+std::vector<wf::config::binding_conflict_t> wf::config::find_binding_conflicts(
+    const config_manager_t& config, std::string_view option_name)
+{
+    auto option = config.get_option(option_name);
+    if (!option)
+    {
+        return {};
+    }
+
+    return config.priv->get_bindings().find_conflicts(option.get());
+}
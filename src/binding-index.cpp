@@ -0,0 +1,502 @@
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <wayfire/config/option-types.hpp>
+
+#include "binding-index.hpp"
+#include "config-manager-impl.hpp"
+#include "section-impl.hpp"
+
+namespace
+{
+uint64_t pack(uint32_t high, uint32_t low)
+{
+    return ((uint64_t)high << 32) | low;
+}
+
+uint64_t gesture_key(const wf::touchgesture_t& gesture)
+{
+    return pack(gesture.get_type(), gesture.get_finger_count());
+}
+
+wf::keybinding_t unpack_key(uint64_t key)
+{
+    return {(uint32_t)(key >> 32), (uint32_t)key};
+}
+
+wf::buttonbinding_t unpack_button(uint64_t button)
+{
+    return {(uint32_t)(button >> 32), (uint32_t)button};
+}
+
+wf::touchgesture_t unpack_gesture(uint64_t key, uint32_t direction)
+{
+    return {(wf::touch_gesture_type_t)(key >> 32), direction, (int)(uint32_t)key};
+}
+
+bool is_binding_option(const wf::config::option_base_t *option)
+{
+    using namespace wf::config;
+    return dynamic_cast<const option_t<wf::keybinding_t>*>(option) ||
+           dynamic_cast<const option_t<wf::buttonbinding_t>*>(option) ||
+           dynamic_cast<const option_t<wf::touchgesture_t>*>(option) ||
+           dynamic_cast<const option_t<wf::activatorbinding_t>*>(option);
+}
+
+/**
+ * Add a conflict for @binding to @conflicts if there is more than one entry.
+ * Each option occurs at most once in @entries.
+ */
+template<class Entry>
+void add_conflict(std::vector<wf::config::binding_conflict_t>& conflicts,
+    const std::string& binding, const std::vector<Entry*>& entries)
+{
+    if (entries.size() < 2)
+    {
+        return;
+    }
+
+    wf::config::binding_conflict_t conflict;
+    conflict.binding = binding;
+    for (auto entry : entries)
+    {
+        conflict.options.push_back(entry->name);
+    }
+
+    std::sort(conflict.options.begin(), conflict.options.end());
+    conflicts.push_back(std::move(conflict));
+}
+
+/** Sort the conflicts by binding and remove duplicates. */
+void sort_conflicts(std::vector<wf::config::binding_conflict_t>& conflicts)
+{
+    std::sort(conflicts.begin(), conflicts.end(),
+        [] (const auto& a, const auto& b)
+    {
+        return (a.binding < b.binding) ||
+               ((a.binding == b.binding) && (a.options < b.options));
+    });
+    conflicts.erase(std::unique(conflicts.begin(), conflicts.end()), conflicts.end());
+}
+
+template<class Entry>
+void add_to_bucket(std::unordered_map<uint64_t, std::vector<Entry*>>& map,
+    uint64_t key, Entry *entry)
+{
+    auto& bucket = map[key];
+    if (std::find(bucket.begin(), bucket.end(), entry) == bucket.end())
+    {
+        bucket.push_back(entry);
+    }
+}
+
+template<class Entry>
+void remove_from_bucket(std::unordered_map<uint64_t, std::vector<Entry*>>& map,
+    uint64_t key, Entry *entry)
+{
+    auto it = map.find(key);
+    if (it == map.end())
+    {
+        return;
+    }
+
+    auto& bucket = it->second;
+    bucket.erase(std::remove(bucket.begin(), bucket.end(), entry), bucket.end());
+    if (bucket.empty())
+    {
+        map.erase(it);
+    }
+}
+}
+
+wf::config::binding_index_t::binding_index_t(config_manager_t::impl *manager) :
+    manager(manager), owner(std::this_thread::get_id())
+{}
+
+wf::config::binding_index_t::~binding_index_t()
+{
+    for (auto& section : sections)
+    {
+        for (auto& entry : section.second.options)
+        {
+            entry->option->rem_updated_handler(&entry->on_updated);
+        }
+    }
+}
+
+void wf::config::binding_index_t::index_option(indexed_option_t& entry)
+{
+    auto add_key = [&] (const keybinding_t& key)
+    {
+        if (key.get_modifiers() || key.get_key())
+        {
+            entry.keys.push_back(pack(key.get_modifiers(), key.get_key()));
+        }
+    };
+
+    auto add_button = [&] (const buttonbinding_t& button)
+    {
+        if (button.get_modifiers() || button.get_button())
+        {
+            entry.buttons.push_back(pack(button.get_modifiers(), button.get_button()));
+        }
+    };
+
+    auto add_gesture = [&] (const touchgesture_t& gesture)
+    {
+        if (gesture.get_type() != GESTURE_TYPE_NONE)
+        {
+            entry.gestures.push_back(gesture);
+        }
+    };
+
+    auto option = entry.option.get();
+    if (auto key = dynamic_cast<option_t<keybinding_t>*>(option))
+    {
+        add_key(key->get_value());
+    } else if (auto button = dynamic_cast<option_t<buttonbinding_t>*>(option))
+    {
+        add_button(button->get_value());
+    } else if (auto gesture = dynamic_cast<option_t<touchgesture_t>*>(option))
+    {
+        add_gesture(gesture->get_value());
+    } else if (auto activator = dynamic_cast<option_t<activatorbinding_t>*>(option))
+    {
+        auto& value = activator->get_value();
+        std::for_each(value.get_keys().begin(), value.get_keys().end(), add_key);
+        std::for_each(value.get_buttons().begin(), value.get_buttons().end(), add_button);
+        std::for_each(value.get_gestures().begin(), value.get_gestures().end(),
+            add_gesture);
+        for (auto& hotspot : value.get_hotspots())
+        {
+            if (hotspot.get_edges())
+            {
+                entry.hotspots.push_back(hotspot);
+            }
+        }
+    }
+
+    for (auto key : entry.keys)
+    {
+        add_to_bucket(by_key, key, &entry);
+    }
+
+    for (auto button : entry.buttons)
+    {
+        add_to_bucket(by_button, button, &entry);
+    }
+
+    for (auto& gesture : entry.gestures)
+    {
+        add_to_bucket(by_gesture, gesture_key(gesture), &entry);
+    }
+
+    for (auto& hotspot : entry.hotspots)
+    {
+        add_to_bucket(by_hotspot, hotspot.get_edges(), &entry);
+    }
+}
+
+void wf::config::binding_index_t::unindex_option(indexed_option_t& entry)
+{
+    for (auto key : entry.keys)
+    {
+        remove_from_bucket(by_key, key, &entry);
+    }
+
+    for (auto button : entry.buttons)
+    {
+        remove_from_bucket(by_button, button, &entry);
+    }
+
+    for (auto& gesture : entry.gestures)
+    {
+        remove_from_bucket(by_gesture, gesture_key(gesture), &entry);
+    }
+
+    for (auto& hotspot : entry.hotspots)
+    {
+        remove_from_bucket(by_hotspot, hotspot.get_edges(), &entry);
+    }
+
+    entry.keys.clear();
+    entry.buttons.clear();
+    entry.gestures.clear();
+    entry.hotspots.clear();
+}
+
+void wf::config::binding_index_t::index_section(const section_t& section,
+    indexed_section_t& indexed)
+{
+    for (auto& entry : indexed.options)
+    {
+        unindex_option(*entry);
+        entry->option->rem_updated_handler(&entry->on_updated);
+        by_option.erase(entry->option.get());
+    }
+
+    indexed.options.clear();
+    for (auto& option : section.priv->options)
+    {
+        if (!is_binding_option(option.second.get()))
+        {
+            continue;
+        }
+
+        auto entry = std::make_unique<indexed_option_t>();
+        entry->option     = option.second;
+        entry->name       = section.get_name() + "/" + option.first;
+        entry->on_updated = [this, ptr = entry.get()] ()
+        {
+            assert((std::this_thread::get_id() == owner) &&
+                "Binding options must be modified on the thread which uses the index");
+            unindex_option(*ptr);
+            index_option(*ptr);
+        };
+
+        entry->option->add_updated_handler(&entry->on_updated);
+        index_option(*entry);
+        by_option[entry->option.get()] = entry.get();
+        indexed.options.push_back(std::move(entry));
+    }
+
+    indexed.generation = section.priv->generation;
+}
+
+void wf::config::binding_index_t::sync()
+{
+    assert(std::this_thread::get_id() == owner);
+
+    // Lazy sections without bindings are not built here, but they may still be
+    // built by lookups on other threads, so the sections must be read under
+    // the lock while there are lazy sections left.
+    std::unique_lock<std::recursive_mutex> lock(manager->lazy_mutex, std::defer_lock);
+    if (manager->has_lazy_sections.load(std::memory_order_acquire))
+    {
+        lock.lock();
+        manager->materialize_bindings();
+    }
+
+    // Sections are never removed, so a new section changes the count
+    uint64_t generation = section_t::impl::global_generation.load(
+        std::memory_order_relaxed);
+    if ((manager->sections.size() == known_sections) &&
+        (generation == known_generation))
+    {
+        return;
+    }
+
+    for (auto& section : manager->sections)
+    {
+        auto& indexed = sections[section.second.get()];
+        if (indexed.generation != section.second->priv->generation)
+        {
+            index_section(*section.second, indexed);
+        }
+    }
+
+    known_sections   = manager->sections.size();
+    known_generation = generation;
+}
+
+wf::config::binding_index_t::option_list_t wf::config::binding_index_t::find(
+    const keybinding_t& key)
+{
+    sync();
+    option_list_t result;
+    auto it = by_key.find(pack(key.get_modifiers(), key.get_key()));
+    if (it != by_key.end())
+    {
+        for (auto entry : it->second)
+        {
+            result.push_back(entry->option);
+        }
+    }
+
+    return result;
+}
+
+wf::config::binding_index_t::option_list_t wf::config::binding_index_t::find(
+    const buttonbinding_t& button)
+{
+    sync();
+    option_list_t result;
+    auto it = by_button.find(pack(button.get_modifiers(), button.get_button()));
+    if (it != by_button.end())
+    {
+        for (auto entry : it->second)
+        {
+            result.push_back(entry->option);
+        }
+    }
+
+    return result;
+}
+
+wf::config::binding_index_t::option_list_t wf::config::binding_index_t::find(
+    const touchgesture_t& gesture)
+{
+    sync();
+    option_list_t result;
+    auto it = by_gesture.find(gesture_key(gesture));
+    if (it != by_gesture.end())
+    {
+        for (auto entry : it->second)
+        {
+            bool matches = std::any_of(entry->gestures.begin(), entry->gestures.end(),
+                [&] (const touchgesture_t& candidate) { return candidate == gesture; });
+            if (matches)
+            {
+                result.push_back(entry->option);
+            }
+        }
+    }
+
+    return result;
+}
+
+std::vector<uint32_t> wf::config::binding_index_t::gesture_directions(
+    const std::vector<indexed_option_t*>& bucket, uint64_t key)
+{
+    std::vector<uint32_t> directions;
+    if ((key >> 32) == GESTURE_TYPE_PINCH)
+    {
+        directions = {GESTURE_DIRECTION_IN, GESTURE_DIRECTION_OUT};
+    } else
+    {
+        directions = {GESTURE_DIRECTION_LEFT, GESTURE_DIRECTION_RIGHT,
+            GESTURE_DIRECTION_UP, GESTURE_DIRECTION_DOWN};
+    }
+
+    // Combined directions, like up-left
+    for (auto entry : bucket)
+    {
+        for (auto& gesture : entry->gestures)
+        {
+            auto direction = gesture.get_direction();
+            if ((gesture_key(gesture) == key) && direction &&
+                (std::find(directions.begin(), directions.end(), direction) ==
+                 directions.end()))
+            {
+                directions.push_back(direction);
+            }
+        }
+    }
+
+    return directions;
+}
+
+void wf::config::binding_index_t::add_gesture_conflicts(
+    std::vector<binding_conflict_t>& conflicts,
+    const std::vector<indexed_option_t*>& bucket, uint64_t key, uint32_t direction)
+{
+    std::vector<indexed_option_t*> matching;
+    for (auto entry : bucket)
+    {
+        bool matches = std::any_of(entry->gestures.begin(), entry->gestures.end(),
+            [&] (const touchgesture_t& candidate)
+        {
+            return (gesture_key(candidate) == key) &&
+                   ((candidate.get_direction() == direction) ||
+                    (candidate.get_direction() == 0));
+        });
+        if (matches)
+        {
+            matching.push_back(entry);
+        }
+    }
+
+    add_conflict(conflicts, option_type::to_string(unpack_gesture(key, direction)),
+        matching);
+}
+
+std::vector<wf::config::binding_conflict_t> wf::config::binding_index_t::find_conflicts()
+{
+    sync();
+    std::vector<binding_conflict_t> conflicts;
+    for (auto& [key, bucket] : by_key)
+    {
+        add_conflict(conflicts, option_type::to_string(unpack_key(key)), bucket);
+    }
+
+    for (auto& [button, bucket] : by_button)
+    {
+        add_conflict(conflicts, option_type::to_string(unpack_button(button)), bucket);
+    }
+
+    for (auto& [edges, bucket] : by_hotspot)
+    {
+        // The hotspots only have to share the edges, so describe the conflict
+        // by the first of them.
+        for (auto& hotspot : bucket.front()->hotspots)
+        {
+            if (hotspot.get_edges() == edges)
+            {
+                add_conflict(conflicts, option_type::to_string(hotspot), bucket);
+                break;
+            }
+        }
+    }
+
+    // Gestures without a direction match the gestures in all directions, so
+    // check each direction separately.
+    for (auto& [key, bucket] : by_gesture)
+    {
+        for (auto direction : gesture_directions(bucket, key))
+        {
+            add_gesture_conflicts(conflicts, bucket, key, direction);
+        }
+    }
+
+    sort_conflicts(conflicts);
+    return conflicts;
+}
+
+std::vector<wf::config::binding_conflict_t> wf::config::binding_index_t::find_conflicts(
+    const option_base_t *option)
+{
+    sync();
+    std::vector<binding_conflict_t> conflicts;
+    auto it = by_option.find(option);
+    if (it == by_option.end())
+    {
+        return conflicts;
+    }
+
+    auto& entry = *it->second;
+    for (auto key : entry.keys)
+    {
+        add_conflict(conflicts, option_type::to_string(unpack_key(key)), by_key[key]);
+    }
+
+    for (auto button : entry.buttons)
+    {
+        add_conflict(conflicts, option_type::to_string(unpack_button(button)),
+            by_button[button]);
+    }
+
+    for (auto& hotspot : entry.hotspots)
+    {
+        add_conflict(conflicts, option_type::to_string(hotspot),
+            by_hotspot[hotspot.get_edges()]);
+    }
+
+    for (auto& gesture : entry.gestures)
+    {
+        auto key     = gesture_key(gesture);
+        auto& bucket = by_gesture[key];
+        if (gesture.get_direction())
+        {
+            add_gesture_conflicts(conflicts, bucket, key, gesture.get_direction());
+            continue;
+        }
+
+        for (auto direction : gesture_directions(bucket, key))
+        {
+            add_gesture_conflicts(conflicts, bucket, key, direction);
+        }
+    }
+
+    sort_conflicts(conflicts);
+    return conflicts;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <wayfire/config/binding-conflicts.hpp>
+#include <wayfire/config/config-manager.hpp>
+#include <wayfire/config/types.hpp>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * Maps keybindings, buttonbindings and touch gestures to the options of a
+ * config manager which are activated by them. The options which are indexed
+ * are options of type keybinding_t, buttonbinding_t, touchgesture_t and
+ * activatorbinding_t. Hotspots of activators are indexed by their edges.
+ * Disabled bindings are not indexed.
+ *
+ * The index is updated incrementally: sections whose options have been
+ * registered or unregistered are re-scanned on the next lookup, and options
+ * are re-indexed when they notify that their value changed.
+ *
+ * Lazy sections are built on the first lookup only if their schema declares
+ * binding options.
+ *
+ * The index belongs to the thread which created it, the owning thread of the
+ * config manager. Its handlers are direct handlers of the options, so the
+ * binding options must only be modified on that thread while the index
+ * exists. This is asserted.
+ */
+class binding_index_t
+{
+  public:
+    binding_index_t(config_manager_t::impl *manager);
+    binding_index_t(const binding_index_t& other) = delete;
+    binding_index_t& operator =(const binding_index_t& other) = delete;
+    ~binding_index_t();
+
+    using option_list_t = std::vector<std::shared_ptr<option_base_t>>;
+    option_list_t find(const keybinding_t& key);
+    option_list_t find(const buttonbinding_t& button);
+    option_list_t find(const touchgesture_t& gesture);
+
+    /** @return All conflicts between the indexed options. */
+    std::vector<binding_conflict_t> find_conflicts();
+
+    /** @return The conflicts which involve the given option. */
+    std::vector<binding_conflict_t> find_conflicts(const option_base_t *option);
+
+  private:
+    struct indexed_option_t
+    {
+        std::shared_ptr<option_base_t> option;
+        option_base_t::updated_callback_t on_updated;
+
+        // Full name of the option, section/option
+        std::string name;
+
+        // The bindings under which the option is currently indexed
+        std::vector<uint64_t> keys;
+        std::vector<uint64_t> buttons;
+        std::vector<touchgesture_t> gestures;
+        std::vector<hotspot_binding_t> hotspots;
+    };
+
+    struct indexed_section_t
+    {
+        uint64_t generation = 0;
+        std::vector<std::unique_ptr<indexed_option_t>> options;
+    };
+
+    config_manager_t::impl *manager;
+    // The thread which created the index
+    std::thread::id owner;
+
+    // State of the config manager when the index was last synchronized
+    size_t known_sections = 0;
+    uint64_t known_generation = 0;
+    std::unordered_map<const section_t*, indexed_section_t> sections;
+
+    std::unordered_map<uint64_t, std::vector<indexed_option_t*>> by_key;
+    std::unordered_map<uint64_t, std::vector<indexed_option_t*>> by_button;
+    // Gestures may have a wildcard direction, so they are indexed by type and
+    // finger count, and the direction is checked on lookup.
+    std::unordered_map<uint64_t, std::vector<indexed_option_t*>> by_gesture;
+    std::unordered_map<uint64_t, std::vector<indexed_option_t*>> by_hotspot;
+    std::unordered_map<const option_base_t*, indexed_option_t*> by_option;
+
+    /** Re-scan sections which have changed since the last lookup. */
+    void sync();
+    void index_section(const section_t& section, indexed_section_t& entry);
+
+    /** Recompute the bindings of @entry and update the maps. */
+    void index_option(indexed_option_t& entry);
+    void unindex_option(indexed_option_t& entry);
+
+    /**
+     * @return The directions in which the gestures of @bucket, with type and
+     *   finger count @key, are checked for conflicts: the basic directions of
+     *   the gesture type and the other directions used in the bucket.
+     */
+    static std::vector<uint32_t> gesture_directions(
+        const std::vector<indexed_option_t*>& bucket, uint64_t key);
+
+    /**
+     * Add a conflict if more than one option in @bucket has a gesture with type
+     * and finger count @key, and @direction or no direction.
+     */
+    void add_gesture_conflicts(std::vector<binding_conflict_t>& conflicts,
+        const std::vector<indexed_option_t*>& bucket, uint64_t key, uint32_t direction);
+};
+}
+}
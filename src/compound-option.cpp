@@ -1,12 +1,13 @@
 #include <wayfire/config/compound-option.hpp>
 #include <wayfire/config/xml.hpp>
 #include "option-impl.hpp"
+#include "section-impl.hpp"
 
 using namespace wf::config;
 
 static bool begins_with(const std::string& a, const std::string& b)
 {
-    return a.substr(0, b.size()) == b;
+    return a.compare(0, b.size(), b) == 0;
 }
 
 compound_option_t::compound_option_t(const std::string& name,
@@ -21,11 +22,11 @@ void wf::config::update_compound_from_section(
     compound_option_t& compound,
     const std::shared_ptr<section_t>& section)
 {
-    const auto& options = section->get_registered_options();
+    const auto& options = section->priv->options;
 
     const auto& should_ignore_option = [] (const std::shared_ptr<wf::config::option_base_t>& opt)
     {
-        return xml::get_option_xml_node(opt) || !opt->priv->option_in_config_file;
+        return opt->priv->is_from_xml() || !opt->priv->option_in_config_file;
     };
 
     const auto& entries = compound.get_entries();
@@ -33,7 +34,7 @@ void wf::config::update_compound_from_section(
     std::map<std::string, std::vector<std::string>> new_values;
 
     // find possible suffixes
-    for (const auto& opt : options)
+    for (const auto& [name, opt] : options)
     {
         if (should_ignore_option(opt))
         {
@@ -46,9 +47,9 @@ void wf::config::update_compound_from_section(
         for (auto it = entries.rbegin(); it != entries.rend(); ++it)
         {
             const auto& entry = *it;
-            if (begins_with(opt->get_name(), entry->get_prefix()))
+            if (begins_with(name, entry->get_prefix()))
             {
-                new_values.emplace(opt->get_name().substr(entry->get_prefix().size()), entries.size() + 1);
+                new_values.emplace(name.substr(entry->get_prefix().size()), entries.size() + 1);
                 break;
             }
         }
@@ -128,8 +129,12 @@ bool compound_option_t::set_value_untyped(stored_type_t value)
         }
     }
 
-    this->value = value;
-    notify_updated();
+    if (this->value != value)
+    {
+        this->value = std::move(value);
+        notify_updated();
+    }
+
     return true;
 }
 
@@ -161,7 +166,7 @@ bool wf::config::compound_option_t::set_value_str(const std::string&)
 
 void wf::config::compound_option_t::reset_to_default()
 {
-    this->value.clear();
+    set_value_untyped({});
 }
 
 bool wf::config::compound_option_t::set_default_value_str(const std::string&)
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <wayfire/config/config-manager.hpp>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "binding-index.hpp"
+
+struct wf::config::config_manager_t::impl
+{
+  public:
+    /* The sections which have already been built */
+    std::map<std::string, std::shared_ptr<section_t>, std::less<>> sections;
+
+    /* Builders of the sections which have not been accessed yet, in the order
+     * in which they were added */
+    std::map<std::string, std::vector<section_builder_t>, std::less<>> lazy_sections;
+
+    /* The lazy sections which may contain binding options. They are built
+     * when the binding index is used, the others are not needed for it. */
+    std::set<std::string, std::less<>> lazy_binding_sections;
+
+    /* Lookups may happen on other threads than the owning one, so lazy
+     * sections are built under the lock. Once there are no lazy sections left,
+     * lookups only read, and the lock is not needed. Recursive, because
+     * builders may look up other sections. */
+    std::recursive_mutex lazy_mutex;
+    std::atomic<bool> has_lazy_sections{false};
+
+    /* An option resolved with get_option_handle() */
+    struct handle_entry_t
+    {
+        /* Sections are never removed, so the section of an option is fixed */
+        std::shared_ptr<section_t> section;
+        std::string option_name;
+
+        /* The option when the section had the given generation */
+        std::shared_ptr<option_base_t> option;
+        uint64_t generation;
+    };
+
+    /* The handles, indexed by their ID, and the IDs by option name */
+    std::vector<handle_entry_t> handles;
+    std::map<std::string, uint32_t, std::less<>> handle_ids;
+
+    /* Size of the configuration when it was last saved to a string, used to
+     * size the buffer for the next save */
+    size_t last_serialized_size = 0;
+
+    /* Reverse index of the bindings, built on first use */
+    std::unique_ptr<binding_index_t> bindings;
+
+    binding_index_t& get_bindings()
+    {
+        if (!bindings)
+        {
+            bindings = std::make_unique<binding_index_t>(this);
+        }
+
+        return *bindings;
+    }
+
+    /**
+     * Add @section to the sections, merging it with an existing section with
+     * the same name.
+     */
+    void merge(std::shared_ptr<section_t> section);
+
+    /**
+     * Add a lazy section, see config_manager_t::merge_lazy_section().
+     *
+     * @param may_have_bindings false if the section is known to have no
+     *   options which the binding index needs.
+     */
+    void merge_lazy(const std::string& name, section_builder_t builder,
+        bool may_have_bindings);
+
+    /**
+     * Build the lazy section with the given name, if there is one.
+     * Must be called with lazy_mutex held.
+     */
+    void materialize(std::string_view name);
+
+    /** Build all lazy sections. Takes lazy_mutex if needed. */
+    void materialize_all();
+
+    /**
+     * Build the lazy sections which may have bindings.
+     * Must be called with lazy_mutex held.
+     */
+    void materialize_bindings();
+};
@@ -2,26 +2,24 @@
 #include <cassert>
 #include <map>
 
-struct wf::config::config_manager_t::impl
-{
-    std::map<std::string, std::shared_ptr<section_t>> sections;
-};
+#include "config-manager-impl.hpp"
+#include "option-impl.hpp"
+#include "section-impl.hpp"
 
-void wf::config::config_manager_t::merge_section(
-    std::shared_ptr<section_t> section)
+void wf::config::config_manager_t::impl::merge(std::shared_ptr<section_t> section)
 {
     assert(section);
-    if (this->priv->sections.count(section->get_name()) == 0)
+    auto it = this->sections.find(section->get_name());
+    if (it == this->sections.end())
     {
         /* Did not exist previously, just add the new section */
-        this->priv->sections[section->get_name()] = section;
+        this->sections.emplace(section->get_name(), section);
         return;
     }
 
     /* Merge with existing config section */
-    auto existing_section = get_section(section->get_name());
-    auto merging_options  = section->get_registered_options();
-    for (auto& option : merging_options)
+    auto existing_section = it->second;
+    section->for_each_option([&] (const std::shared_ptr<option_base_t>& option)
     {
         auto existing_option =
             existing_section->get_option_or(option->get_name());
@@ -33,15 +31,109 @@ void wf::config::config_manager_t::merge_section(
         {
             existing_section->register_new_option(option);
         }
+    });
+}
+
+void wf::config::config_manager_t::impl::materialize(std::string_view name)
+{
+    auto it = lazy_sections.find(name);
+    if (it == lazy_sections.end())
+    {
+        return;
+    }
+
+    /* Remove the builders first, in case they access the config manager.
+     * @name may point into either container, so find it in both before
+     * erasing anything. */
+    auto binding_it = lazy_binding_sections.find(name);
+    auto builders   = std::move(it->second);
+    lazy_sections.erase(it);
+    if (binding_it != lazy_binding_sections.end())
+    {
+        lazy_binding_sections.erase(binding_it);
     }
+
+    for (auto& builder : builders)
+    {
+        merge(builder());
+    }
+
+    /* Readers skip the lock once the flag is cleared, so this must happen
+     * only after the last section has been inserted. */
+    if (lazy_sections.empty())
+    {
+        has_lazy_sections.store(false, std::memory_order_release);
+    }
+}
+
+void wf::config::config_manager_t::impl::materialize_all()
+{
+    if (!has_lazy_sections.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(lazy_mutex);
+    while (!lazy_sections.empty())
+    {
+        materialize(lazy_sections.begin()->first);
+    }
+}
+
+void wf::config::config_manager_t::impl::materialize_bindings()
+{
+    while (!lazy_binding_sections.empty())
+    {
+        materialize(*lazy_binding_sections.begin());
+    }
+}
+
+void wf::config::config_manager_t::impl::merge_lazy(const std::string& name,
+    section_builder_t builder, bool may_have_bindings)
+{
+    assert(builder);
+    std::lock_guard<std::recursive_mutex> lock(lazy_mutex);
+    lazy_sections[name].push_back(std::move(builder));
+    if (may_have_bindings)
+    {
+        lazy_binding_sections.insert(name);
+    }
+
+    has_lazy_sections = true;
+}
+
+void wf::config::config_manager_t::merge_section(
+    std::shared_ptr<section_t> section)
+{
+    assert(section);
+    std::lock_guard<std::recursive_mutex> lock(this->priv->lazy_mutex);
+    this->priv->materialize(section->get_name());
+    this->priv->merge(section);
+}
+
+void wf::config::config_manager_t::merge_lazy_section(const std::string& name,
+    section_builder_t builder)
+{
+    /* The builder may return anything */
+    this->priv->merge_lazy(name, std::move(builder), true);
 }
 
 std::shared_ptr<wf::config::section_t> wf::config::config_manager_t::get_section(
-    const std::string& name) const
+    std::string_view name) const
 {
-    if (this->priv->sections.count(name))
+    /* Lazy sections are rare after startup, avoid the lock and a second
+     * lookup if there are none. */
+    std::unique_lock<std::recursive_mutex> lock(this->priv->lazy_mutex, std::defer_lock);
+    if (this->priv->has_lazy_sections.load(std::memory_order_acquire))
+    {
+        lock.lock();
+        this->priv->materialize(name);
+    }
+
+    auto it = this->priv->sections.find(name);
+    if (it != this->priv->sections.end())
     {
-        return this->priv->sections.at(name);
+        return it->second;
     }
 
     return nullptr;
@@ -49,6 +141,8 @@ std::shared_ptr<wf::config::section_t> wf::config::config_manager_t::get_section
 
 std::vector<std::shared_ptr<wf::config::section_t>> wf::config::config_manager_t::get_all_sections() const
 {
+    this->priv->materialize_all();
+
     std::vector<std::shared_ptr<wf::config::section_t>> list;
     for (auto& section : this->priv->sections)
     {
@@ -58,11 +152,21 @@ std::vector<std::shared_ptr<wf::config::section_t>> wf::config::config_manager_t
     return list;
 }
 
+void wf::config::config_manager_t::for_each_section(
+    const std::function<void(const std::shared_ptr<section_t>&)>& callback) const
+{
+    this->priv->materialize_all();
+    for (auto& section : this->priv->sections)
+    {
+        callback(section.second);
+    }
+}
+
 std::shared_ptr<wf::config::option_base_t> wf::config::config_manager_t::get_option(
-    const std::string& name) const
+    std::string_view name) const
 {
-    size_t splitter = name.find_first_of("/");
-    if (splitter == std::string::npos)
+    size_t splitter = name.find('/');
+    if (splitter == std::string_view::npos)
     {
         return nullptr;
     }
@@ -83,6 +187,67 @@ std::shared_ptr<wf::config::option_base_t> wf::config::config_manager_t::get_opt
     return nullptr;
 }
 
+wf::config::option_handle_t wf::config::config_manager_t::get_option_handle(
+    std::string_view name) const
+{
+    auto it = this->priv->handle_ids.find(name);
+    if (it != this->priv->handle_ids.end())
+    {
+        return {it->second};
+    }
+
+    auto option = get_option(name);
+    if (!option)
+    {
+        return {};
+    }
+
+    auto section = get_section(name.substr(0, name.find('/')));
+    uint32_t id  = this->priv->handles.size();
+    this->priv->handles.push_back({section, option->get_name(), option,
+        section->priv->generation});
+    this->priv->handle_ids.emplace(name, id);
+    return {id};
+}
+
+std::shared_ptr<wf::config::option_base_t> wf::config::config_manager_t::get_option(
+    option_handle_t handle) const
+{
+    if (handle.id >= this->priv->handles.size())
+    {
+        return nullptr;
+    }
+
+    /* Options are only added, replaced or removed together with a change of
+     * the generation of their section. */
+    auto& entry = this->priv->handles[handle.id];
+    if (entry.generation != entry.section->priv->generation)
+    {
+        entry.option     = entry.section->get_option_or(entry.option_name);
+        entry.generation = entry.section->priv->generation;
+    }
+
+    return entry.option;
+}
+
+std::vector<std::shared_ptr<wf::config::option_base_t>> wf::config::config_manager_t::
+get_options_for_binding(const keybinding_t& key) const
+{
+    return this->priv->get_bindings().find(key);
+}
+
+std::vector<std::shared_ptr<wf::config::option_base_t>> wf::config::config_manager_t::
+get_options_for_binding(const buttonbinding_t& button) const
+{
+    return this->priv->get_bindings().find(button);
+}
+
+std::vector<std::shared_ptr<wf::config::option_base_t>> wf::config::config_manager_t::
+get_options_for_binding(const touchgesture_t& gesture) const
+{
+    return this->priv->get_bindings().find(gesture);
+}
+
 wf::config::config_manager_t::config_manager_t()
 {
     this->priv = std::make_unique<impl>();
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <libevdev/libevdev.h>
+
+#include "evdev-names.hpp"
+
+namespace
+{
+/** FNV-1a with a seed, followed by a finalizer to mix the high bits down. */
+uint32_t hash_name(uint32_t seed, std::string_view name)
+{
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (unsigned char c : name)
+    {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+bool starts_with(std::string_view str, std::string_view prefix)
+{
+    return str.substr(0, prefix.size()) == prefix;
+}
+}
+
+const wf::config::evdev_names_t& wf::config::evdev_names_t::get()
+{
+    static const evdev_names_t table;
+    return table;
+}
+
+wf::config::evdev_names_t::evdev_names_t()
+{
+    int max_code = libevdev_event_type_get_max(EV_KEY);
+    std::vector<slot_t> entries;
+    for (int code = 0; code <= max_code; code++)
+    {
+        names.push_back(libevdev_event_code_get_name(EV_KEY, code));
+        if (names.back())
+        {
+            entries.push_back({names.back(), code});
+        }
+    }
+
+    size_t table_size = 1;
+    while (table_size < entries.size())
+    {
+        table_size *= 2;
+    }
+
+    while (!build(entries, table_size))
+    {
+        table_size *= 2;
+    }
+}
+
+bool wf::config::evdev_names_t::build(const std::vector<slot_t>& entries,
+    size_t table_size)
+{
+    // Hash and displace: the names are distributed to buckets of about four
+    // names each, and for each bucket, starting with the largest, we search
+    // for a seed which puts all of its names into free slots.
+    static constexpr uint32_t MAX_SEED = 1 << 16;
+    size_t nr_buckets = std::max<size_t>(1, entries.size() / 4);
+    std::vector<std::vector<const slot_t*>> buckets(nr_buckets);
+    for (auto& entry : entries)
+    {
+        buckets[hash_name(0, entry.name) % nr_buckets].push_back(&entry);
+    }
+
+    std::vector<size_t> order(nr_buckets);
+    for (size_t i = 0; i < nr_buckets; i++)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b)
+    {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    seeds.assign(nr_buckets, 0);
+    slots.assign(table_size, {});
+    std::vector<size_t> positions;
+    for (auto i : order)
+    {
+        auto& bucket = buckets[i];
+        bool placed  = bucket.empty();
+        for (uint32_t seed = 1; !placed && (seed < MAX_SEED); seed++)
+        {
+            positions.clear();
+            for (auto entry : bucket)
+            {
+                size_t pos = hash_name(seed, entry->name) & (table_size - 1);
+                if (slots[pos].name ||
+                    (std::find(positions.begin(), positions.end(), pos) != positions.end()))
+                {
+                    break;
+                }
+
+                positions.push_back(pos);
+            }
+
+            if (positions.size() == bucket.size())
+            {
+                seeds[i] = seed;
+                for (size_t j = 0; j < bucket.size(); j++)
+                {
+                    slots[positions[j]] = *bucket[j];
+                }
+
+                placed = true;
+            }
+        }
+
+        if (!placed)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t wf::config::evdev_names_t::find_slot(std::string_view name) const
+{
+    uint32_t seed = seeds[hash_name(0, name) % seeds.size()];
+    return hash_name(seed, name) & (slots.size() - 1);
+}
+
+int wf::config::evdev_names_t::code_from_name(std::string_view name) const
+{
+    auto& slot = slots[find_slot(name)];
+    if (slot.name && (name == slot.name))
+    {
+        return slot.code;
+    }
+
+    // The table only contains the names returned by
+    // libevdev_event_code_get_name(), but libevdev also accepts aliases of
+    // some codes, for example BTN_MISC for BTN_0.
+    if (starts_with(name, "KEY_") || starts_with(name, "BTN_"))
+    {
+        return libevdev_event_code_from_name_n(EV_KEY, name.data(), name.size());
+    }
+
+    return -1;
+}
+
+const char *wf::config::evdev_names_t::name_from_code(uint32_t code) const
+{
+    return (code < names.size()) ? names[code] : nullptr;
+}
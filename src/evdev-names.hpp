@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * A table of the names of the EV_KEY event codes (KEY_* and BTN_*), for fast
+ * lookups in both directions.
+ *
+ * The table is built from libevdev on first use, so it always matches the
+ * installed version of libevdev. Names are looked up with a perfect
+ * hash function, so a lookup hashes the name twice and compares it with a
+ * single candidate.
+ */
+class evdev_names_t
+{
+  public:
+    /** @return The table, built on the first call. */
+    static const evdev_names_t& get();
+
+    /**
+     * @return The code of the key or button with the given name, or -1 if
+     *   there is no such name. Same as libevdev_event_code_from_name(EV_KEY).
+     */
+    int code_from_name(std::string_view name) const;
+
+    /**
+     * @return The name of the given code, or nullptr if the code has no name.
+     *   Same as libevdev_event_code_get_name(EV_KEY).
+     */
+    const char *name_from_code(uint32_t code) const;
+
+  private:
+    evdev_names_t();
+
+    struct slot_t
+    {
+        const char *name = nullptr;
+        int code = -1;
+    };
+
+    // The names of the codes, indexed by code
+    std::vector<const char*> names;
+
+    // The hash table: a name is in the slot given by the hash with the seed
+    // of its bucket.
+    std::vector<uint32_t> seeds;
+    std::vector<slot_t> slots;
+
+    bool build(const std::vector<slot_t>& entries, size_t table_size);
+    size_t find_slot(std::string_view name) const;
+};
+}
+}
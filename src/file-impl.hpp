@@ -0,0 +1,15 @@
+#pragma once
+
+#include <wayfire/config/config-manager.hpp>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * Use the options in the @sysconf file as default values for the options in
+ * @manager, and reset the options to the new defaults.
+ */
+void override_defaults(config_manager_t& manager, const std::string& sysconf);
+}
+}
@@ -3,200 +3,176 @@
 #include <wayfire/config/types.hpp>
 #include <wayfire/config/xml.hpp>
 #include <wayfire/util/log.hpp>
-#include <sstream>
 #include <fstream>
-#include <cassert>
+#include <functional>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <optional>
 #include <set>
+#include <string_view>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
+#include "config-manager-impl.hpp"
+#include "file-impl.hpp"
 #include "option-impl.hpp"
+#include "section-impl.hpp"
+#include "schema-cache.hpp"
 
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 
-class line_t : public std::string
+/**
+ * A logical line of a config source, i.e. one or more physical lines joined by
+ * a trailing '\', with comments and trailing whitespace removed.
+ */
+struct line_t
 {
-  public:
-    template<class T>
-    line_t(T source) : std::string(source)
-    {}
-
-    line_t() : std::string()
-    {}
-    line_t(const line_t& other) = default;
-    line_t(line_t&& other) = default;
-    line_t& operator =(const line_t& other) = default;
-    line_t& operator =(line_t&& other) = default;
-
-  public:
-    line_t substr(size_t start, size_t length = npos) const
-    {
-        line_t result = std::string::substr(start, length);
-        result.source_line_number = this->source_line_number;
-        return result;
-    }
-
+    std::string_view text;
+    /** Number of the first physical line, counting from 1. */
     size_t source_line_number;
+    /** Offsets of the physical lines in the source, including the newline. */
+    size_t source_begin;
+    size_t source_end;
 };
 
-using lines_t = std::vector<line_t>;
-
-static lines_t split_to_lines(const std::string& source)
-{
-    std::istringstream stream(source);
-    lines_t output;
-    line_t line;
-
-    size_t line_idx = 1;
-    while (std::getline(stream, line))
-    {
-        line.source_line_number = line_idx;
-        output.push_back(line);
-        ++line_idx;
-    }
-
-    return output;
-}
-
 /**
- * Check whether at the given index @idx in @line, there is a character
- * @ch which isn't escaped (i.e preceded by \).
+ * Splits a config source into its non-empty logical lines in a single pass.
+ *
+ * The returned lines point directly into the source. Only lines which contain
+ * escaped '#' characters or which are continued on the next line are copied to
+ * an internal buffer, which is reused and therefore invalidated on the next
+ * call to next().
  */
-static bool is_nonescaped(const std::string& line, char ch, int idx)
-{
-    return line[idx] == ch && (idx == 0 || line[idx - 1] != '\\');
-}
-
-static size_t find_first_nonescaped(const std::string& line, char ch)
+class line_tokenizer_t
 {
-    /* Find first not-escaped # */
-    size_t pos = 0;
-    while (pos != std::string::npos && !is_nonescaped(line, ch, pos))
-    {
-        pos = line.find(ch, pos + 1);
-    }
-
-    return pos;
-}
-
-line_t remove_escaped_sharps(const line_t& line)
-{
-    line_t result;
-    result.source_line_number = line.source_line_number;
+  public:
+    line_tokenizer_t(std::string_view source) : source(source)
+    {}
 
-    bool had_escape = false;
-    for (auto& ch : line)
+    /**
+     * Read the next non-empty logical line.
+     * @return false if the end of the source has been reached.
+     */
+    bool next(line_t& line)
     {
-        if ((ch == '#') && had_escape)
+        while (position < source.size())
         {
-            result.pop_back();
-        }
-
-        result    += ch;
-        had_escape = (ch == '\\');
-    }
+            line.source_line_number = line_number + 1;
+            line.source_begin = position;
 
-    return result;
-}
+            bool continues;
+            auto text = read_physical_line(continues);
 
-static lines_t remove_comments(const lines_t& lines)
-{
-    lines_t result;
-    for (const auto& line : lines)
-    {
-        auto pos = find_first_nonescaped(line, '#');
-        result.push_back(
-            remove_escaped_sharps(line.substr(0, pos)));
-    }
+            /* Every '#' left after removing the comment is escaped */
+            if (continues || (text.find('#') != std::string_view::npos))
+            {
+                buffer.clear();
+                append_unescaped(text);
+                while (continues && position < source.size())
+                {
+                    append_unescaped(read_physical_line(continues));
+                }
 
-    return result;
-}
+                text = buffer;
+            }
 
-static lines_t remove_trailing_whitespace(const lines_t& lines)
-{
-    lines_t result;
-    for (const auto& line : lines)
-    {
-        auto result_line = line;
-        while (!result_line.empty() && std::isspace(result_line.back()))
-        {
-            result_line.pop_back();
+            if (!text.empty())
+            {
+                line.text = text;
+                line.source_end = position;
+                return true;
+            }
         }
 
-        result.push_back(result_line);
+        return false;
     }
 
-    return result;
-}
-
-lines_t join_lines(const lines_t& lines)
-{
-    lines_t result;
-    bool in_concat_mode = false;
-
-    for (const auto& line : lines)
+  private:
+    std::string_view source;
+    size_t position    = 0;
+    size_t line_number = 0;
+    std::string buffer;
+
+    /**
+     * Read the next physical line and strip the comment and trailing
+     * whitespace from it. If the line ends in a non-escaped '\', the '\' is
+     * removed and @continues is set to true.
+     */
+    std::string_view read_physical_line(bool& continues)
     {
-        if (in_concat_mode)
-        {
-            assert(!result.empty());
-            result.back() += line;
-        } else
+        size_t end = source.find('\n', position);
+        if (end == std::string_view::npos)
         {
-            result.push_back(line);
+            end = source.size();
         }
 
-        if (result.empty() || result.back().empty())
-        {
-            in_concat_mode = false;
-        } else
+        auto line = source.substr(position, end - position);
+        position = std::min(end + 1, source.size());
+        ++line_number;
+
+        /* Find first not-escaped # */
+        for (size_t i = 0; i < line.size(); i++)
         {
-            in_concat_mode = (result.back().back() == '\\');
-            if (in_concat_mode) /* pop last \ */
+            if ((line[i] == '#') && ((i == 0) || (line[i - 1] != '\\')))
             {
-                result.back().pop_back();
+                line = line.substr(0, i);
+                break;
             }
+        }
+
+        while (!line.empty() && std::isspace((unsigned char)line.back()))
+        {
+            line.remove_suffix(1);
+        }
 
+        continues = false;
+        if (!line.empty() && (line.back() == '\\'))
+        {
+            line.remove_suffix(1);
             /* If last \ was escaped, we should ignore it */
-            bool was_escaped =
-                !result.back().empty() && result.back().back() == '\\';
-            in_concat_mode = in_concat_mode && !was_escaped;
+            continues = line.empty() || (line.back() != '\\');
         }
-    }
 
-    return result;
-}
+        return line;
+    }
 
-lines_t skip_empty(const lines_t& lines)
-{
-    lines_t result;
-    for (auto& line : lines)
+    /** Append @line to the buffer, replacing each escaped '\#' with '#'. */
+    void append_unescaped(std::string_view line)
     {
-        if (!line.empty())
+        for (size_t i = 0; i < line.size(); i++)
         {
-            result.push_back(line);
+            if ((line[i] == '\\') && (i + 1 < line.size()) && (line[i + 1] == '#'))
+            {
+                continue;
+            }
+
+            buffer += line[i];
         }
     }
+};
 
-    return result;
-}
-
-static std::string ignore_leading_trailing_whitespace(const std::string& string)
+static std::string_view ignore_leading_trailing_whitespace(std::string_view string)
 {
     if (string.empty())
     {
-        return "";
+        return {};
     }
 
     size_t i = 0;
     size_t j = string.size() - 1;
-    while (i < j && std::isspace(string[i]))
+    while (i < j && std::isspace((unsigned char)string[i]))
     {
         ++i;
     }
 
-    while (i < j && std::isspace(string[j]))
+    while (i < j && std::isspace((unsigned char)string[j]))
     {
         --j;
     }
@@ -224,14 +200,14 @@ static option_parsing_result parse_option_line(
     wf::config::section_t& current_section, const line_t& line,
     std::set<std::shared_ptr<wf::config::option_base_t>>& reloaded)
 {
-    size_t equal_sign = line.find_first_of("=");
-    if (equal_sign == std::string::npos)
+    size_t equal_sign = line.text.find('=');
+    if (equal_sign == std::string_view::npos)
     {
         return OPTION_PARSED_WRONG_FORMAT;
     }
 
-    auto name  = ignore_leading_trailing_whitespace(line.substr(0, equal_sign));
-    auto value = ignore_leading_trailing_whitespace(line.substr(equal_sign + 1));
+    std::string name{ignore_leading_trailing_whitespace(line.text.substr(0, equal_sign))};
+    std::string value{ignore_leading_trailing_whitespace(line.text.substr(equal_sign + 1))};
 
     auto option = current_section.get_option_or(name);
     if (!option)
@@ -251,6 +227,23 @@ static option_parsing_result parse_option_line(
     return OPTION_PARSED_INVALID_CONTENTS;
 }
 
+/**
+ * Check whether the @line is a valid section start.
+ *
+ * @return The name of the section, or std::nullopt if the line is not a section
+ *   start.
+ */
+static std::optional<std::string_view> get_section_name(const line_t& line)
+{
+    auto name = ignore_leading_trailing_whitespace(line.text);
+    if (name.empty() || (name.front() != '[') || (name.back() != ']'))
+    {
+        return {};
+    }
+
+    return name.substr(1, name.length() - 2);
+}
+
 /**
  * Check whether the @line is a valid section start. If yes, it will either return the section in @config with
  * the same name, or create a new section and register it in config.
@@ -260,13 +253,13 @@ static option_parsing_result parse_option_line(
 static std::shared_ptr<wf::config::section_t> check_section(
     wf::config::config_manager_t& config, const line_t& line)
 {
-    auto name = ignore_leading_trailing_whitespace(line);
-    if (name.empty() || (name.front() != '[') || (name.back() != ']'))
+    auto name = get_section_name(line);
+    if (!name)
     {
         return {};
     }
 
-    auto real_name = name.substr(1, name.length() - 2);
+    std::string real_name{*name};
 
     auto section = config.get_section(real_name);
     if (!section)
@@ -296,27 +289,165 @@ static std::shared_ptr<wf::config::section_t> check_section(
     return section;
 }
 
-void wf::config::load_configuration_options_from_string(
-    config_manager_t& config, const std::string& source,
-    const std::string& source_name)
+/* FNV-1a, used to fingerprint the lines of each section in a config source. */
+static constexpr uint64_t FINGERPRINT_BASIS = 0xcbf29ce484222325ULL;
+
+static uint64_t fingerprint_line(uint64_t hash, std::string_view line)
 {
-    std::set<std::shared_ptr<option_base_t>> reloaded;
+    for (unsigned char c : line)
+    {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+
+    /* Separator, so that line boundaries are part of the fingerprint */
+    return (hash ^ '\n') * 0x100000001b3ULL;
+}
+
+/**
+ * Compute the fingerprint of the lines of each section in @source.
+ * Sections which do not appear in the source have FINGERPRINT_BASIS.
+ */
+static std::map<std::string, uint64_t, std::less<>> fingerprint_sections(
+    std::string_view source)
+{
+    std::map<std::string, uint64_t, std::less<>> fingerprints;
+    uint64_t *current = nullptr;
+
+    line_tokenizer_t tokenizer{source};
+    line_t line;
+    while (tokenizer.next(line))
+    {
+        if (auto name = get_section_name(line))
+        {
+            auto it = fingerprints.find(*name);
+            if (it == fingerprints.end())
+            {
+                it = fingerprints.emplace(std::string{*name}, FINGERPRINT_BASIS).first;
+            }
+
+            current = &it->second;
+        } else if (current)
+        {
+            *current = fingerprint_line(*current, line.text);
+        }
+    }
+
+    return fingerprints;
+}
+
+/** @return The sum of the generations of all options in the section. */
+static uint64_t sum_option_generations(const wf::config::section_t& section)
+{
+    uint64_t sum = 0;
+    for (auto& [name, option] : section.priv->options)
+    {
+        sum += option->priv->generation;
+    }
+
+    return sum;
+}
+
+/**
+ * A section can be skipped on reload if its lines have not changed since it
+ * was last loaded, and neither its options nor their values, default values
+ * or lock state have been changed by anyone else in the meantime.
+ */
+static bool is_section_unchanged(const wf::config::section_t& section,
+    uint64_t fingerprint)
+{
+    const auto& last = section.priv->last_load;
+    return last.valid && (last.fingerprint == fingerprint) &&
+           (last.generation == section.priv->generation) &&
+           (last.option_generations == sum_option_generations(section));
+}
+
+/**
+ * Parse @source and apply it to @config, see load_configuration_options_from_string().
+ *
+ * Sections whose lines have not changed since the last load are skipped.
+ */
+static void load_configuration_options(wf::config::config_manager_t& config,
+    std::string_view source, const std::string& source_name,
+    wf::config::config_change_set_t *changes)
+{
+    using namespace wf::config;
+
+    auto fingerprints = fingerprint_sections(source);
+    const auto& get_fingerprint = [&] (const std::string& name)
+    {
+        auto it = fingerprints.find(name);
+        return (it == fingerprints.end()) ? FINGERPRINT_BASIS : it->second;
+    };
+
+    /* Build the lazy sections which are mentioned in the source. The others
+     * still have their default values, so there is nothing to reset. */
+    std::unique_lock<std::recursive_mutex> lock(config.priv->lazy_mutex);
+    for (auto& [name, fingerprint] : fingerprints)
+    {
+        config.priv->materialize(name);
+        size_t splitter = name.find(':');
+        if (splitter != std::string::npos)
+        {
+            config.priv->materialize(name.substr(0, splitter));
+        }
+    }
+
+    lock.unlock();
+
+    std::vector<std::shared_ptr<section_t>> changed_sections;
+    std::set<section_t*> unchanged_sections;
+    std::set<section_t*> known_sections;
+    for (auto& [name, section] : config.priv->sections)
+    {
+        known_sections.insert(section.get());
+        if (is_section_unchanged(*section, get_fingerprint(section->get_name())))
+        {
+            unchanged_sections.insert(section.get());
+        } else
+        {
+            changed_sections.push_back(section);
+        }
+    }
+
+    // State of the options before reloading, used to compute the change set
+    struct option_state_t
+    {
+        uint64_t generation;
+        bool in_config_file;
+    };
 
-    auto lines =
-        skip_empty(
-            join_lines(
-                remove_trailing_whitespace(
-                    remove_comments(
-                        split_to_lines(source)))));
+    std::map<option_base_t*, option_state_t> previous_state;
+    if (changes)
+    {
+        for (auto& section : changed_sections)
+        {
+            for (auto& [name, opt] : section->priv->options)
+            {
+                previous_state[opt.get()] = {opt->priv->generation,
+                    opt->priv->option_in_config_file};
+            }
+        }
+    }
 
+    std::set<std::shared_ptr<option_base_t>> reloaded;
     std::shared_ptr<wf::config::section_t> current_section;
+    bool skip_current_section = false;
 
-    for (const auto& line : lines)
+    line_tokenizer_t tokenizer{source};
+    line_t line;
+    while (tokenizer.next(line))
     {
         auto next_section = check_section(config, line);
         if (next_section)
         {
             current_section = next_section;
+            skip_current_section = (unchanged_sections.count(next_section.get()) > 0);
+            if (known_sections.insert(next_section.get()).second)
+            {
+                /* Section was created while parsing */
+                changed_sections.push_back(next_section);
+            }
+
             continue;
         }
 
@@ -327,6 +458,11 @@ void wf::config::load_configuration_options_from_string(
             continue;
         }
 
+        if (skip_current_section)
+        {
+            continue;
+        }
+
         auto status = parse_option_line(*current_section, line, reloaded);
         switch (status)
         {
@@ -348,16 +484,18 @@ void wf::config::load_configuration_options_from_string(
 
     // Go through all options and reset options which are loaded from the config
     // string but are not there anymore.
-    for (auto section : config.get_all_sections())
+    for (auto& section : changed_sections)
     {
-        for (auto opt : section->get_registered_options())
+        for (auto& [name, opt] : section->priv->options)
         {
             opt->priv->option_in_config_file = (reloaded.count(opt) > 0);
 
             opt->priv->is_part_compound  = false; // will be re-set when updating compound options
             opt->priv->could_be_compound = false; // will be re-set when updating compound options
 
-            if (!opt->priv->option_in_config_file && !opt->is_locked())
+            // Compound options are rebuilt from the section below
+            if (!opt->priv->option_in_config_file && !opt->is_locked() &&
+                !std::dynamic_pointer_cast<compound_option_t>(opt))
             {
                 opt->reset_to_default();
             }
@@ -366,9 +504,9 @@ void wf::config::load_configuration_options_from_string(
 
     // After resetting all options which are no longer in the config file, make
     // sure to rebuild compound options as well.
-    for (auto section : config.get_all_sections())
+    for (auto& section : changed_sections)
     {
-        for (auto opt : section->get_registered_options())
+        for (auto& [name, opt] : section->priv->options)
         {
             auto as_compound = std::dynamic_pointer_cast<compound_option_t>(opt);
             if (as_compound)
@@ -378,11 +516,11 @@ void wf::config::load_configuration_options_from_string(
         }
     }
 
-    for (auto section : config.get_all_sections())
+    for (auto& section : changed_sections)
     {
-        for (auto opt : section->get_registered_options())
+        for (auto& [name, opt] : section->priv->options)
         {
-            if (!opt->priv->xml && !opt->priv->is_part_compound)
+            if (!opt->priv->is_from_xml() && !opt->priv->is_part_compound)
             {
                 if (opt->priv->could_be_compound)
                 {
@@ -398,143 +536,754 @@ void wf::config::load_configuration_options_from_string(
             }
         }
     }
-}
 
-std::string wf::config::save_configuration_options_to_string(
-    const config_manager_t& config)
-{
-    std::vector<std::string> lines;
-
-    for (auto& section : config.get_all_sections())
+    if (changes)
     {
-        lines.push_back("[" + section->get_name() + "]");
-
-        // Go through each option and add the necessary lines.
-        // Take care so that regular options overwrite compound options
-        // in case of conflict!
-        std::map<std::string, std::string> option_values;
-        std::set<std::string> all_compound_prefixes;
-        for (auto& option : section->get_registered_options())
+        for (auto& section : changed_sections)
         {
-            auto as_compound = std::dynamic_pointer_cast<compound_option_t>(option);
-            if (as_compound)
+            changes->sections.push_back(section);
+            for (auto& [name, opt] : section->priv->options)
             {
-                auto value = as_compound->get_value_untyped();
-                const auto& prefixes = as_compound->get_entries();
-                for (auto& p : prefixes)
+                auto it = previous_state.find(opt.get());
+                bool was_in_file = (it != previous_state.end()) && it->second.in_config_file;
+                bool is_new = (it == previous_state.end());
+
+                if (is_new || (it->second.generation != opt->priv->generation))
                 {
-                    all_compound_prefixes.insert(p->get_prefix());
+                    changes->changed.push_back({section, opt});
                 }
 
-                for (size_t i = 0; i < value.size(); i++)
+                if (!was_in_file && opt->priv->option_in_config_file)
                 {
-                    for (size_t j = 0; j < prefixes.size(); j++)
-                    {
-                        auto full_name = prefixes[j]->get_prefix() + value[i][0];
-                        option_values[full_name] = value[i][j + 1];
-                    }
+                    changes->added.push_back({section, opt});
+                } else if (was_in_file && !opt->priv->option_in_config_file)
+                {
+                    changes->removed.push_back({section, opt});
                 }
             }
         }
+    }
 
-        // An option is part of a compound option if it begins with any of the
-        // prefixes.
-        const auto& is_part_of_compound_option = [&] (const std::string& name)
-        {
-            return std::any_of(
-                all_compound_prefixes.begin(), all_compound_prefixes.end(),
-                [&] (const auto& prefix)
-            {
-                return name.substr(0, prefix.size()) == prefix;
-            });
-        };
+    // Remember the state of the sections, so that the next reload can skip
+    // them if nothing changes.
+    for (auto& section : changed_sections)
+    {
+        auto& last = section->priv->last_load;
+        last.valid = true;
+        last.fingerprint = get_fingerprint(section->get_name());
+        last.generation  = section->priv->generation;
+        last.option_generations = sum_option_generations(*section);
+    }
+}
 
-        for (auto& option : section->get_registered_options())
-        {
-            auto as_compound = std::dynamic_pointer_cast<compound_option_t>(option);
-            if (!as_compound)
-            {
-                // Check whether this option does not conflict with a compound
-                // option entry.
-                if (xml::get_option_xml_node(option) ||
-                    !is_part_of_compound_option(option->get_name()))
-                {
-                    option_values[option->get_name()] = option->get_value_str();
-                }
-            }
-        }
+void wf::config::load_configuration_options_from_string(
+    config_manager_t& config, const std::string& source,
+    const std::string& source_name)
+{
+    notification_batch_t batch;
+    load_configuration_options(config, source, source_name, nullptr);
+}
 
-        for (auto& [name, value] : option_values)
-        {
-            lines.push_back(name + " = " + value);
-        }
+void wf::config::load_configuration_options_from_string(
+    config_manager_t& config, const std::string& source,
+    const std::string& source_name, config_change_set_t& changes)
+{
+    notification_batch_t batch;
+    load_configuration_options(config, source, source_name, &changes);
+}
+
+namespace
+{
+/** A destination for serialized configuration. */
+class output_sink_t
+{
+  public:
+    virtual ~output_sink_t() = default;
+    virtual void write(std::string_view data) = 0;
+};
+
+class string_sink_t : public output_sink_t
+{
+  public:
+    /** @param expected_size The expected size of the output, reserved upfront. */
+    string_sink_t(size_t expected_size = 0)
+    {
+        result.reserve(expected_size);
+    }
+
+    std::string result;
+    void write(std::string_view data) override
+    {
+        result.append(data);
+    }
+};
+
+class ostream_sink_t : public output_sink_t
+{
+  public:
+    ostream_sink_t(std::ostream& out) : out(out)
+    {}
+
+    void write(std::string_view data) override
+    {
+        out.write(data.data(), data.size());
+    }
+
+  private:
+    std::ostream& out;
+};
 
-        lines.push_back("");
+/** Buffers output and writes it to a file descriptor in large chunks. */
+class fd_sink_t : public output_sink_t
+{
+  public:
+    fd_sink_t(int fd) : fd(fd)
+    {
+        buffer.reserve(BUFFER_SIZE);
     }
 
-    /* Check which characters need escaping */
-    for (auto& line : lines)
+    void write(std::string_view data) override
     {
-        size_t sharp = line.find_first_of("#");
-        while (sharp != line.npos)
+        if (buffer.size() + data.size() > BUFFER_SIZE)
         {
-            line.insert(line.begin() + sharp, '\\');
-            sharp = line.find_first_of("#", sharp + 2);
+            flush();
         }
 
-        if (!line.empty() && (line.back() == '\\'))
+        if (data.size() > BUFFER_SIZE)
+        {
+            write_to_fd(data);
+        } else
         {
-            line += '\\';
+            buffer.append(data);
         }
     }
 
-    std::string result;
-    for (const auto& line : lines)
+    /** @return False if any of the writes so far has failed. */
+    bool flush()
     {
-        result += line + "\n";
+        write_to_fd(buffer);
+        buffer.clear();
+        return !failed;
     }
 
-    return result;
+  private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+    int fd;
+    bool failed = false;
+    std::string buffer;
+
+    void write_to_fd(std::string_view data)
+    {
+        while (!data.empty() && !failed)
+        {
+            ssize_t written = ::write(fd, data.data(), data.size());
+            if ((written < 0) && (errno != EINTR))
+            {
+                failed = true;
+            } else if (written > 0)
+            {
+                data.remove_prefix(written);
+            }
+        }
+    }
+};
 }
 
-static std::string load_file_contents(const std::string& file)
+/**
+ * Write a part of a line, escaping '#' so that it is not parsed as a comment.
+ */
+static void write_escaped(output_sink_t& out, std::string_view data)
 {
-    std::ifstream infile(file);
-    std::string file_contents((std::istreambuf_iterator<char>(infile)),
-        std::istreambuf_iterator<char>());
+    size_t sharp;
+    while ((sharp = data.find('#')) != data.npos)
+    {
+        out.write(data.substr(0, sharp));
+        out.write("\\#");
+        data.remove_prefix(sharp + 1);
+    }
 
-    return file_contents;
+    out.write(data);
 }
 
-bool wf::config::load_configuration_options_from_file(config_manager_t& manager,
-    const std::string& file)
+/** The lines to be written for a section, as (name, value) pairs. */
+struct section_values_t
 {
-    /* Try to lock the file */
-    auto fd = open(file.c_str(), O_RDONLY);
-    if (flock(fd, LOCK_SH | LOCK_NB))
+    /** Sorted by name, without duplicates. */
+    std::vector<std::pair<std::string, std::string>> values;
+    /** Prefixes of all compound options in the section. */
+    std::vector<std::string> compound_prefixes;
+
+    /** @return Whether the option is part of a compound option. */
+    bool is_part_of_compound_option(std::string_view name) const
     {
-        close(fd);
-        return false;
+        return std::any_of(compound_prefixes.begin(), compound_prefixes.end(),
+            [&] (const auto& prefix)
+        {
+            return name.compare(0, prefix.size(), prefix) == 0;
+        });
     }
+};
 
-    auto file_contents = load_file_contents(file);
+static void collect_section_values(const wf::config::section_t& section,
+    section_values_t& result)
+{
+    using namespace wf::config;
+
+    auto& option_values = result.values;
+    option_values.clear();
+    result.compound_prefixes.clear();
+
+    // Go through each option and add the necessary lines.
+    // Take care so that regular options overwrite compound options
+    // in case of conflict!
+    const auto& options = section.priv->options;
+    for (auto& [name, option] : options)
+    {
+        auto as_compound = dynamic_cast<compound_option_t*>(option.get());
+        if (as_compound)
+        {
+            auto value = as_compound->get_value_untyped();
+            const auto& prefixes = as_compound->get_entries();
+            for (auto& p : prefixes)
+            {
+                result.compound_prefixes.push_back(p->get_prefix());
+            }
+
+            for (size_t i = 0; i < value.size(); i++)
+            {
+                for (size_t j = 0; j < prefixes.size(); j++)
+                {
+                    option_values.emplace_back(
+                        prefixes[j]->get_prefix() + value[i][0],
+                        std::move(value[i][j + 1]));
+                }
+            }
+        }
+    }
+
+    for (auto& [name, option] : options)
+    {
+        if (!dynamic_cast<compound_option_t*>(option.get()))
+        {
+            // Check whether this option does not conflict with a compound
+            // option entry.
+            if (option->priv->is_from_xml() ||
+                !result.is_part_of_compound_option(name))
+            {
+                option_values.emplace_back(name, option->get_value_str());
+            }
+        }
+    }
+
+    // Sort by name. For duplicate names, the value added last wins.
+    std::stable_sort(option_values.begin(), option_values.end(),
+        [] (const auto& a, const auto& b) { return a.first < b.first; });
+    auto last = std::unique(option_values.rbegin(), option_values.rend(),
+        [] (const auto& a, const auto& b) { return a.first == b.first; });
+    option_values.erase(option_values.begin(), last.base());
+}
+
+/** Write a complete option line. */
+static void write_option_line(output_sink_t& out, std::string_view name,
+    std::string_view value)
+{
+    write_escaped(out, name);
+    out.write(" = ");
+    write_escaped(out, value);
+
+    // A trailing backslash would join the line with the next one
+    out.write((!value.empty() && (value.back() == '\\')) ? "\\\n" : "\n");
+}
+
+/**
+ * Write the line of a plain option. String values are written directly,
+ * without copying them with get_value_str().
+ */
+static void write_option_line(output_sink_t& out, std::string_view name,
+    const wf::config::option_base_t& option)
+{
+    using string_option_t = wf::config::option_t<std::string>;
+    if (auto as_string = dynamic_cast<const string_option_t*>(&option))
+    {
+        write_option_line(out, name, as_string->get_value());
+    } else
+    {
+        write_option_line(out, name, option.get_value_str());
+    }
+}
+
+static void serialize_configuration(const wf::config::config_manager_t& config,
+    output_sink_t& out)
+{
+    using namespace wf::config;
+
+    section_values_t section_values;
+    config.for_each_section([&] (const std::shared_ptr<section_t>& section)
+    {
+        out.write("[");
+        write_escaped(out, section->priv->name);
+        out.write("]\n");
+
+        const auto& options = section->priv->options;
+        bool has_compound = std::any_of(options.begin(), options.end(),
+            [] (const auto& option)
+        {
+            return dynamic_cast<compound_option_t*>(option.second.get()) != nullptr;
+        });
+
+        if (has_compound)
+        {
+            /* The entries of compound options have to be merged with the
+             * other options */
+            collect_section_values(*section, section_values);
+            for (const auto& [name, value] : section_values.values)
+            {
+                write_option_line(out, name, value);
+            }
+        } else
+        {
+            /* The options are already sorted by name */
+            for (const auto& [name, option] : options)
+            {
+                write_option_line(out, name, *option);
+            }
+        }
+
+        out.write("\n");
+    });
+}
+
+/**
+ * @return An estimate of the size of the serialized configuration, used to
+ *   reserve the output buffer.
+ */
+static size_t estimate_serialized_size(const wf::config::config_manager_t& config)
+{
+    /* Usually, the configuration has barely changed since it was last saved */
+    size_t last = config.priv->last_serialized_size;
+    if (last > 0)
+    {
+        return last + last / 8;
+    }
+
+    size_t estimate = 0;
+    config.for_each_section([&] (const std::shared_ptr<wf::config::section_t>& section)
+    {
+        estimate += section->priv->name.size() + 4;
+        for (const auto& [name, option] : section->priv->options)
+        {
+            estimate += name.size() + 32;
+        }
+    });
+
+    return estimate;
+}
+
+std::string wf::config::save_configuration_options_to_string(
+    const config_manager_t& config)
+{
+    string_sink_t sink{estimate_serialized_size(config)};
+    serialize_configuration(config, sink);
+    config.priv->last_serialized_size = sink.result.size();
+    return std::move(sink.result);
+}
 
-    /* Release lock */
+void wf::config::save_configuration_options_to_stream(
+    const config_manager_t& config, std::ostream& out)
+{
+    ostream_sink_t sink{out};
+    serialize_configuration(config, sink);
+}
+
+/**
+ * Read the whole contents of an open file with as few reads as possible.
+ *
+ * The file is not mapped into memory: config files are small, and a mapped
+ * file which is truncated by another writer, for example an editor which does
+ * not take the lock, would raise SIGBUS while it is parsed.
+ */
+static std::string read_file_contents(int fd)
+{
+    struct stat st;
+    if ((fd < 0) || fstat(fd, &st))
+    {
+        return {};
+    }
+
+    /* st_size is only a hint, the file may change while it is read */
+    std::string buffer;
+    size_t size = 0;
+    buffer.resize(std::max<off_t>(st.st_size, 4096) + 1);
+    while (true)
+    {
+        ssize_t r = read(fd, &buffer[size], buffer.size() - size);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if (r == 0)
+        {
+            break;
+        }
+
+        size += r;
+        if (size == buffer.size())
+        {
+            buffer.resize(buffer.size() * 2);
+        }
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+
+/**
+ * Load the options from the given config file, see
+ * load_configuration_options_from_file().
+ */
+static bool load_configuration_options_from_locked_file(
+    wf::config::config_manager_t& manager, const std::string& file,
+    wf::config::config_change_set_t *changes)
+{
+    /* Try to lock the file */
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (flock(fd, LOCK_SH | LOCK_NB))
+    {
+        close(fd);
+        return false;
+    }
+
+    /* We have our own copy, so writers do not need to wait for parsing */
+    std::string contents = read_file_contents(fd);
     flock(fd, LOCK_UN);
     close(fd);
 
-    load_configuration_options_from_string(manager, file_contents, file);
+    load_configuration_options(manager, contents, file, changes);
     return true;
 }
 
-void wf::config::save_configuration_to_file(
-    const wf::config::config_manager_t& manager, const std::string& file)
+bool wf::config::load_configuration_options_from_file(config_manager_t& manager,
+    const std::string& file)
 {
-    auto contents = save_configuration_options_to_string(manager);
-    contents.pop_back(); // remove last newline
+    // Notifications are delivered only after the file has been unlocked
+    notification_batch_t batch;
+    return load_configuration_options_from_locked_file(manager, file, nullptr);
+}
 
-    auto fd = open(file.c_str(), O_RDONLY);
-    flock(fd, LOCK_EX);
+bool wf::config::load_configuration_options_from_file(config_manager_t& manager,
+    const std::string& file, config_change_set_t& changes)
+{
+    notification_batch_t batch;
+    return load_configuration_options_from_locked_file(manager, file, &changes);
+}
+
+/**
+ * The layout of a config source: where each section ends and where the line of
+ * each option is, so that the source can be updated in place.
+ */
+struct config_document_t
+{
+    struct option_line_t
+    {
+        /** Span of the physical lines in the source. */
+        size_t begin, end;
+        std::string value;
+    };
+
+    struct section_info_t
+    {
+        /** Where new options should be inserted. */
+        size_t append_at;
+        /** If an option is set multiple times, only the last line is kept. */
+        std::map<std::string, option_line_t, std::less<>> options;
+    };
+
+    std::map<std::string, section_info_t, std::less<>> sections;
+};
+
+static config_document_t parse_document(std::string_view source)
+{
+    config_document_t document;
+    config_document_t::section_info_t *current = nullptr;
+
+    line_tokenizer_t tokenizer{source};
+    line_t line;
+    while (tokenizer.next(line))
+    {
+        if (auto name = get_section_name(line))
+        {
+            /* Sections may be repeated, new options go to the last one */
+            current = &document.sections[std::string{*name}];
+            current->append_at = line.source_end;
+            continue;
+        }
+
+        if (!current)
+        {
+            continue;
+        }
+
+        current->append_at = line.source_end;
+        size_t equal_sign = line.text.find('=');
+        if (equal_sign != std::string_view::npos)
+        {
+            auto name  = ignore_leading_trailing_whitespace(line.text.substr(0, equal_sign));
+            auto value = ignore_leading_trailing_whitespace(line.text.substr(equal_sign + 1));
+            current->options[std::string{name}] =
+            {line.source_begin, line.source_end, std::string{value}};
+        }
+    }
+
+    return document;
+}
+
+/**
+ * Generate the new text of an option line, keeping the formatting of the
+ * existing @line (indentation, spacing, trailing comment) where possible.
+ */
+static std::string patch_option_line(std::string_view line, std::string_view name,
+    std::string_view value)
+{
+    string_sink_t out{line.size() + value.size() + 1};
+    bool has_newline = !line.empty() && (line.back() == '\n');
+    if (has_newline)
+    {
+        line.remove_suffix(1);
+    }
+
+    size_t equal_sign = line.find('=');
+    if ((line.find('\n') != std::string_view::npos) ||
+        (equal_sign == std::string_view::npos))
+    {
+        /* Continued lines are simply rewritten */
+        write_option_line(out, name, value);
+        return std::move(out.result);
+    }
+
+    size_t value_start = equal_sign + 1;
+    while ((value_start < line.size()) && std::isspace((unsigned char)line[value_start]))
+    {
+        ++value_start;
+    }
+
+    size_t comment_start = line.size();
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        if ((line[i] == '#') && ((i == 0) || (line[i - 1] != '\\')))
+        {
+            comment_start = i;
+            break;
+        }
+    }
+
+    value_start = std::min(value_start, comment_start);
+    size_t value_end = comment_start;
+    while ((value_end > value_start) && std::isspace((unsigned char)line[value_end - 1]))
+    {
+        --value_end;
+    }
+
+    out.write(line.substr(0, value_start));
+
+    /* An empty value may have lost its whitespace after the equal sign, for
+     * ex. `key =`. Mirror the spacing before the equal sign in that case. */
+    if ((value_start == equal_sign + 1) && (value_end == value_start) && !value.empty() &&
+        (equal_sign > 0) && std::isspace((unsigned char)line[equal_sign - 1]))
+    {
+        out.write(" ");
+    }
+
+    write_escaped(out, value);
+    if (!value.empty() && (value.back() == '\\'))
+    {
+        out.write("\\");
+    }
+
+    if ((value_end == comment_start) && (comment_start < line.size()))
+    {
+        out.write(" ");
+    }
+
+    out.write(line.substr(value_end));
+    if (has_newline)
+    {
+        out.write("\n");
+    }
+
+    return std::move(out.result);
+}
+
+/**
+ * @return Whether the @value of the option in the config file represents the
+ *   same value as @new_value.
+ */
+static bool is_same_value(const std::shared_ptr<wf::config::option_base_t>& option,
+    const std::string& value, const std::string& new_value)
+{
+    if (value == new_value)
+    {
+        return true;
+    }
+
+    if (!option)
+    {
+        return false;
+    }
+
+    /* Different representations of the same value, for ex. 1.2 and 1.200000 */
+    auto parsed = option->clone_option();
+    return parsed->set_value_str(value) && (parsed->get_value_str() == new_value);
+}
+
+/**
+ * Update the config @source with the values in @config. Lines of options whose
+ * value has changed are replaced, options which are not in the source yet are
+ * appended to their section, and entries of compound options which have been
+ * removed are deleted. Everything else is kept as it is.
+ *
+ * Options which are not in the source are written only if they do not have
+ * their default value, since they would be reset to it on the next load
+ * anyway.
+ *
+ * @return The updated source, or std::nullopt if nothing has changed.
+ */
+static std::optional<std::string> patch_document(
+    const wf::config::config_manager_t& config, std::string_view source)
+{
+    struct edit_t
+    {
+        size_t begin, end;
+        std::string text;
+    };
+
+    std::vector<edit_t> edits;
+    auto document = parse_document(source);
+    bool ends_with_newline = source.empty() || (source.back() == '\n');
+
+    section_values_t section_values;
+    config.for_each_section([&] (const std::shared_ptr<wf::config::section_t>& section)
+    {
+        collect_section_values(*section, section_values);
+        auto it = document.sections.find(section->get_name());
+
+        string_sink_t new_lines;
+        for (const auto& [name, value] : section_values.values)
+        {
+            auto option = section->get_option_or(name);
+            bool is_regular = option && (option->priv->is_from_xml() ||
+                !section_values.is_part_of_compound_option(name));
+            if (!is_regular)
+            {
+                option = nullptr;
+            }
+
+            if (it != document.sections.end())
+            {
+                auto line = it->second.options.find(name);
+                if (line != it->second.options.end())
+                {
+                    if (!is_same_value(option, line->second.value, value))
+                    {
+                        auto old_line = source.substr(line->second.begin,
+                            line->second.end - line->second.begin);
+                        edits.push_back({line->second.begin, line->second.end,
+                            patch_option_line(old_line, name, value)});
+                    }
+
+                    continue;
+                }
+            }
+
+            if (!option || (value != option->get_default_value_str()))
+            {
+                write_option_line(new_lines, name, value);
+            }
+        }
+
+        if (it == document.sections.end())
+        {
+            if (!new_lines.result.empty())
+            {
+                string_sink_t text;
+                if (!source.empty())
+                {
+                    text.write(ends_with_newline ? "" : "\n");
+                    bool has_blank_line = (source.size() >= 2) &&
+                        (source.substr(source.size() - 2) == "\n\n");
+                    text.write(has_blank_line ? "" : "\n");
+                }
+
+                text.write("[");
+                write_escaped(text, section->get_name());
+                text.write("]\n");
+                text.write(new_lines.result);
+                edits.push_back({source.size(), source.size(), std::move(text.result)});
+            }
+
+            return;
+        }
+
+        /* Remove entries of compound options which do not exist anymore */
+        for (auto& [name, line] : it->second.options)
+        {
+            if (section_values.is_part_of_compound_option(name) &&
+                !std::binary_search(section_values.values.begin(),
+                    section_values.values.end(), std::make_pair(name, std::string{}),
+                    [] (const auto& a, const auto& b) { return a.first < b.first; }))
+            {
+                edits.push_back({line.begin, line.end, ""});
+            }
+        }
+
+        if (!new_lines.result.empty())
+        {
+            size_t at = it->second.append_at;
+            bool needs_newline = (at == source.size()) && !ends_with_newline;
+            edits.push_back({at, at,
+                (needs_newline ? "\n" : "") + std::move(new_lines.result)});
+        }
+    });
+
+    if (edits.empty())
+    {
+        return {};
+    }
+
+    std::stable_sort(edits.begin(), edits.end(),
+        [] (const edit_t& a, const edit_t& b) { return a.begin < b.begin; });
+
+    std::string result;
+    size_t position = 0;
+    for (auto& edit : edits)
+    {
+        result.append(source.substr(position, edit.begin - position));
+        result.append(edit.text);
+        position = edit.end;
+    }
+
+    result.append(source.substr(position));
+    return result;
+}
+
+/**
+ * Replace the contents of the file. @fd is a descriptor of the file which
+ * holds an exclusive lock on it. It is unlocked and closed before the last
+ * byte is written.
+ */
+static void replace_locked_file(int fd, const std::string& file, std::string contents)
+{
+    char last = 0;
+    if (!contents.empty())
+    {
+        last = contents.back();
+        contents.pop_back();
+    }
 
     auto fout = std::ofstream(file, std::ios::trunc);
     fout << contents;
@@ -543,24 +1292,287 @@ void wf::config::save_configuration_to_file(
     close(fd);
 
     /* Modify the file one last time. Now programs waiting for updates can acquire a shared lock. */
-    fout << std::endl;
+    if (last)
+    {
+        fout << last << std::flush;
+    }
+}
+
+/**
+ * Replace the contents of the file while holding an exclusive lock on it.
+ */
+static void write_file_locked(const std::string& file, std::string contents)
+{
+    auto fd = open(file.c_str(), O_RDONLY);
+    flock(fd, LOCK_EX);
+    replace_locked_file(fd, file, std::move(contents));
+}
+
+void wf::config::save_configuration_to_file(
+    const wf::config::config_manager_t& manager, const std::string& file)
+{
+    write_file_locked(file, save_configuration_options_to_string(manager));
+}
+
+/**
+ * @return The file which is replaced when saving to @file: the target of
+ *   @file if it is a symlink, also if the target does not exist yet.
+ */
+static std::string resolve_save_target(const std::string& file)
+{
+    if (char *resolved = realpath(file.c_str(), nullptr))
+    {
+        std::string target = resolved;
+        free(resolved);
+        return target;
+    }
+
+    /* realpath() fails for dangling symlinks, create their target */
+    std::string target = file;
+    struct stat st;
+    for (int i = 0; (i < 40) && (lstat(target.c_str(), &st) == 0) && S_ISLNK(st.st_mode); i++)
+    {
+        std::string link(st.st_size ? st.st_size : PATH_MAX, '\0');
+        ssize_t len = readlink(target.c_str(), link.data(), link.size());
+        if (len <= 0)
+        {
+            break;
+        }
+
+        link.resize(len);
+        auto slash = target.find_last_of('/');
+        if ((link[0] == '/') || (slash == std::string::npos))
+        {
+            target = link;
+        } else
+        {
+            target = target.substr(0, slash + 1) + link;
+        }
+    }
+
+    return target;
 }
 
-static void process_xml_file(wf::config::config_manager_t& manager,
-    const std::string & filename)
+static void write_file_atomic(const std::string& file,
+    const std::function<void(output_sink_t&)>& write_contents)
 {
+    /* Replace the target of symlinks, not the symlinks themselves */
+    std::string target = resolve_save_target(file);
+    auto slash = target.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : target.substr(0, slash + 1);
+    std::string tmp_name = (slash == std::string::npos) ? "" : dir;
+    tmp_name += "." + target.substr(slash + 1) + ".XXXXXX";
+
+    int tmp_fd = mkostemp(tmp_name.data(), O_CLOEXEC);
+    if (tmp_fd < 0)
+    {
+        LOGE("Failed to create a temporary file for ", file, ": ", strerror(errno));
+        return;
+    }
+
+    /* Keep the permissions and the owner of the original file. New files
+     * are created with the same permissions as the non-atomic save would
+     * typically result in. */
+    struct stat st;
+    mode_t mode = 0644;
+    if (stat(target.c_str(), &st) == 0)
+    {
+        mode = st.st_mode & 07777;
+        if (((st.st_uid != geteuid()) || (st.st_gid != getegid())) &&
+            (fchown(tmp_fd, st.st_uid, st.st_gid) != 0))
+        {
+            /* Only root can give files to other users */
+            LOGW("Could not keep the owner of ", target, ": ", strerror(errno));
+        }
+    }
+
+    fd_sink_t sink{tmp_fd};
+    bool ok = (fchmod(tmp_fd, mode) == 0);
+    if (ok)
+    {
+        write_contents(sink);
+        ok = sink.flush();
+    }
+
+    if (!ok || (fsync(tmp_fd) != 0))
+    {
+        LOGE("Failed to write configuration to ", tmp_name, ": ", strerror(errno));
+        close(tmp_fd);
+        unlink(tmp_name.c_str());
+        return;
+    }
+
+    close(tmp_fd);
+
+    /* Readers never see partial contents, the lock only keeps us from racing
+     * with writers which do not use atomic saves. */
+    int fd = open(target.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        flock(fd, LOCK_EX);
+    }
+
+    if (rename(tmp_name.c_str(), target.c_str()) != 0)
+    {
+        LOGE("Failed to replace ", target, ": ", strerror(errno));
+        unlink(tmp_name.c_str());
+    }
+
+    if (fd >= 0)
+    {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    /* Make sure the rename itself survives a crash */
+    int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+void wf::config::save_configuration_to_file(
+    const wf::config::config_manager_t& manager, const std::string& file,
+    uint32_t flags)
+{
+    std::optional<std::string> patched;
+    int fd = -1;
+    if (flags & SAVE_PRESERVE_FORMAT)
+    {
+        fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    if (fd >= 0)
+    {
+        /* Writers following the locking protocol must not change the file
+         * while we read it. Without atomic saves, the exclusive lock is held
+         * until the patched file is written, so that concurrent edits are
+         * not lost. */
+        flock(fd, (flags & SAVE_ATOMIC) ? LOCK_SH : LOCK_EX);
+        patched = patch_document(manager, read_file_contents(fd));
+        if (!patched || (flags & SAVE_ATOMIC))
+        {
+            flock(fd, LOCK_UN);
+            close(fd);
+            fd = -1;
+        }
+
+        if (!patched)
+        {
+            /* Nothing to do, leave the file untouched */
+            return;
+        }
+    }
+
+    if (flags & SAVE_ATOMIC)
+    {
+        write_file_atomic(file, [&] (output_sink_t& out)
+        {
+            if (patched)
+            {
+                out.write(*patched);
+            } else
+            {
+                serialize_configuration(manager, out);
+            }
+        });
+    } else if (fd >= 0)
+    {
+        replace_locked_file(fd, file, std::move(*patched));
+    } else
+    {
+        write_file_locked(file, save_configuration_options_to_string(manager));
+    }
+}
+
+/**
+ * An XML file to be loaded, and the sections loaded from it.
+ */
+struct xml_file_job_t
+{
+    std::string filename;
+    /* Result of stat() on the file, only used when caching */
+    struct stat st;
+    bool has_stat = false;
+    /* Schema from the cache, if it is up to date */
+    const std::vector<wf::config::xml::section_schema_t> *cached = nullptr;
+
+    std::vector<std::shared_ptr<wf::config::section_t>> sections;
+    /* Schema read from the XML file, to be stored in the cache */
+    std::vector<wf::config::xml::section_schema_t> schemas;
+    bool parsed = false;
+    /* Whether the sections and options should keep their XML nodes */
+    bool retain_xml_nodes = true;
+    /* Whether only the schemas are needed, because the sections are built
+     * lazily */
+    bool lazy = false;
+
+    void add_section(wf::config::xml::section_schema_t&& schema)
+    {
+        if (!lazy)
+        {
+            sections.push_back(
+                wf::config::xml::create_section_from_schema(schema, filename));
+        }
+
+        schemas.push_back(std::move(schema));
+    }
+};
+
+/**
+ * Build the sections declared in the XML file of the given job.
+ * Jobs may run in parallel: the state they share is the option type registry
+ * and the cached schemas, which are only read, the log, and the global
+ * generation of sections, which is atomic.
+ */
+static void process_xml_file(xml_file_job_t& job)
+{
+    namespace xml = wf::config::xml;
+    if (job.cached)
+    {
+        for (auto& schema : *job.cached)
+        {
+            job.add_section(xml::section_schema_t{schema});
+        }
+
+        return;
+    }
+
+    if (!job.retain_xml_nodes)
+    {
+        /* No XML nodes are needed, so the document tree is never built */
+        bool ok = xml::read_section_schemas(job.filename,
+            [&] (xml::section_schema_t&& schema)
+        {
+            job.add_section(std::move(schema));
+        });
+
+        if (!ok)
+        {
+            LOGE("Failed to parse XML file ", job.filename);
+            job.sections.clear();
+            job.schemas.clear();
+            return;
+        }
+
+        job.parsed = true;
+        return;
+    }
+
     /* Parse the XML file. */
-    auto doc = xmlParseFile(filename.c_str());
+    auto doc = xmlParseFile(job.filename.c_str());
     if (!doc)
     {
-        LOGE("Failed to parse XML file ", filename);
+        LOGE("Failed to parse XML file ", job.filename);
         return;
     }
 
     auto root = xmlDocGetRootElement(doc);
     if (!root)
     {
-        LOGE(filename, ": missing root element.");
+        LOGE(job.filename, ": missing root element.");
         xmlFreeDoc(doc);
         return;
     }
@@ -573,20 +1585,89 @@ static void process_xml_file(wf::config::config_manager_t& manager,
             (((const char*)section->name == (std::string)"plugin") ||
              ((const char*)section->name == (std::string)"object")))
         {
-            manager.merge_section(
-                wf::config::xml::create_section_from_xml_node(section));
+            /* The metadata can be extracted from the XML nodes when it is
+             * needed, unless the schema is stored in the cache */
+            if (auto schema = xml::extract_section_schema(section, job.has_stat))
+            {
+                job.add_section(std::move(*schema));
+            }
         }
 
         section = section->next;
     }
 
-    // xmlFreeDoc(doc); - May clear the XML nodes before they are used
+    /* The document is not freed: the XML nodes were requested with
+     * retain_xml_nodes, and the sections and options point into it. */
+    job.parsed = true;
 }
 
-static wf::config::config_manager_t load_xml_files(const std::vector<std::string>& xmldirs)
+/**
+ * Run all jobs on a pool of @num_threads threads, including the calling one.
+ */
+static void run_xml_file_jobs(std::vector<xml_file_job_t>& jobs, size_t num_threads)
+{
+    std::atomic<size_t> next_job{0};
+    auto worker = [&] ()
+    {
+        size_t i;
+        while ((i = next_job++) < jobs.size())
+        {
+            process_xml_file(jobs[i]);
+        }
+    };
+
+    num_threads = std::min(num_threads, jobs.size());
+    if (num_threads > 1)
+    {
+        /* Must be done once before libxml2 is used from multiple threads */
+        xmlInitParser();
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++)
+    {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @return Whether a section created from @schema may have options which are
+ *   indexed for get_options_for_binding(). Registered option types other than
+ *   the built-in ones may be bindings too.
+ */
+static bool may_have_bindings(const wf::config::xml::section_schema_t& schema)
+{
+    static const std::set<std::string, std::less<>> plain_types = {
+        "int", "double", "bool", "string", "color", "output::mode",
+        "output::position", "animation", "dynamic-list",
+    };
+
+    return std::any_of(schema.options.begin(), schema.options.end(),
+        [] (const wf::config::xml::option_schema_t& option)
+    {
+        return !plain_types.count(option.type);
+    });
+}
+
+static wf::config::config_manager_t load_xml_files(const std::vector<std::string>& xmldirs,
+    const wf::config::build_options_t& options)
 {
     wf::config::config_manager_t manager;
 
+    std::optional<wf::config::schema_cache_t> cache;
+    if (!options.schema_cache.empty())
+    {
+        cache.emplace(options.schema_cache);
+    }
+
+    std::vector<xml_file_job_t> jobs;
+    std::vector<std::pair<std::string, std::vector<std::string>>> loaded_files;
     for (auto& xmldir : xmldirs)
     {
         auto xmld = opendir(xmldir.c_str());
@@ -596,7 +1677,7 @@ static wf::config::config_manager_t load_xml_files(const std::vector<std::string
             continue;
         }
 
-        std::vector<std::string> loaded_files;
+        loaded_files.push_back({xmldir, {}});
 
         struct dirent *entry;
         while ((entry = readdir(xmld)) != nullptr)
@@ -611,23 +1692,72 @@ static wf::config::config_manager_t load_xml_files(const std::vector<std::string
             if ((filename.length() > 4) &&
                 (filename.rfind(".xml") == filename.length() - 4))
             {
-                process_xml_file(manager, filename);
-                loaded_files.push_back(entry->d_name);
+                xml_file_job_t job;
+                job.filename = filename;
+                job.retain_xml_nodes = options.retain_xml_nodes;
+                job.lazy = options.lazy_sections;
+                job.has_stat = cache && (stat(filename.c_str(), &job.st) == 0);
+                if (job.has_stat)
+                {
+                    job.cached = cache->find(filename, job.st);
+                }
+
+                jobs.push_back(std::move(job));
+                loaded_files.back().second.push_back(entry->d_name);
             }
         }
 
         closedir(xmld);
+    }
+
+    size_t num_threads = options.xml_threads;
+    if (num_threads == 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    run_xml_file_jobs(jobs, num_threads);
+
+    /* Merge in the order of the files, so that the result does not depend on
+     * the number of threads. */
+    for (auto& job : jobs)
+    {
+        for (auto& section : job.sections)
+        {
+            manager.merge_section(section);
+        }
+
+        if (cache && job.has_stat && job.parsed)
+        {
+            cache->store(job.filename, job.st, job.schemas);
+        }
+
+        if (job.lazy)
+        {
+            for (auto& schema : job.schemas)
+            {
+                auto shared = std::make_shared<const wf::config::xml::section_schema_t>(
+                    std::move(schema));
+                manager.priv->merge_lazy(shared->name, [shared, file = job.filename] ()
+                {
+                    return wf::config::xml::create_section_from_schema(*shared, file);
+                }, may_have_bindings(*shared));
+            }
+        }
+    }
 
-        if (!loaded_files.empty())
+    for (auto& [xmldir, files] : loaded_files)
+    {
+        if (!files.empty())
         {
-            LOGI("Loaded XML configuration options from ", loaded_files.size(),
+            LOGI("Loaded XML configuration options from ", files.size(),
                 " files in ", xmldir, ":");
 
             std::string list;
-            for (size_t i = 0; i < loaded_files.size(); ++i)
+            for (size_t i = 0; i < files.size(); ++i)
             {
-                list += loaded_files[i];
-                if (i + 1 != loaded_files.size())
+                list += files[i];
+                if (i + 1 != files.size())
                 {
                     list += ", ";
                 }
@@ -637,21 +1767,32 @@ static wf::config::config_manager_t load_xml_files(const std::vector<std::string
         }
     }
 
+    if (cache)
+    {
+        cache->save();
+    }
+
     return manager;
 }
 
-void override_defaults(wf::config::config_manager_t& manager,
+void wf::config::override_defaults(wf::config::config_manager_t& manager,
     const std::string& sysconf)
 {
-    auto sysconf_str = load_file_contents(sysconf);
+    auto fd = open(sysconf.c_str(), O_RDONLY | O_CLOEXEC);
 
     wf::config::config_manager_t overrides;
-    load_configuration_options_from_string(overrides, sysconf_str, sysconf);
-    for (auto& section : overrides.get_all_sections())
+    load_configuration_options(overrides, read_file_contents(fd), sysconf, nullptr);
+
+    if (fd >= 0)
     {
-        for (auto& option : section->get_registered_options())
+        close(fd);
+    }
+
+    for (auto& [section_name, section] : overrides.priv->sections)
+    {
+        for (auto& [option_name, option] : section->priv->options)
         {
-            auto full_name   = section->get_name() + '/' + option->get_name();
+            auto full_name   = section_name + '/' + option_name;
             auto real_option = manager.get_option(full_name);
             if (real_option)
             {
@@ -678,7 +1819,14 @@ wf::config::config_manager_t wf::config::build_configuration(
     const std::vector<std::string>& xmldirs, const std::string& sysconf,
     const std::string& userconf)
 {
-    auto manager = load_xml_files(xmldirs);
+    return build_configuration(xmldirs, sysconf, userconf, build_options_t{});
+}
+
+wf::config::config_manager_t wf::config::build_configuration(
+    const std::vector<std::string>& xmldirs, const std::string& sysconf,
+    const std::string& userconf, const build_options_t& options)
+{
+    auto manager = load_xml_files(xmldirs, options);
     override_defaults(manager, sysconf);
     load_configuration_options_from_file(manager, userconf);
     return manager;
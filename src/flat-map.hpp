@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace wf
+{
+namespace config
+{
+/**
+ * A map from strings to values, stored as a vector of (key, value) pairs
+ * sorted by key.
+ *
+ * Compared to std::map, the entries are contiguous in memory, so iterating
+ * over all entries does not chase a pointer per entry, and lookups are binary
+ * searches over a single array. Insertions and removals are linear, so it is
+ * meant for maps which are read much more often than they are modified.
+ *
+ * The interface is the subset of std::map which is needed by wf-config.
+ * Lookups accept std::string_view and do not allocate. Note that unlike with
+ * std::map, modifications invalidate iterators and references.
+ */
+template<class Value>
+class flat_map_t
+{
+  public:
+    using value_type     = std::pair<std::string, Value>;
+    using iterator       = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    iterator begin()
+    {
+        return entries.begin();
+    }
+
+    iterator end()
+    {
+        return entries.end();
+    }
+
+    const_iterator begin() const
+    {
+        return entries.begin();
+    }
+
+    const_iterator end() const
+    {
+        return entries.end();
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+
+    iterator find(std::string_view key)
+    {
+        auto it = lower_bound(key);
+        return ((it != entries.end()) && (it->first == key)) ? it : entries.end();
+    }
+
+    const_iterator find(std::string_view key) const
+    {
+        return const_cast<flat_map_t*>(this)->find(key);
+    }
+
+    size_t count(std::string_view key) const
+    {
+        return find(key) != end();
+    }
+
+    /** @return The value for @key, inserting a default value if missing. */
+    Value& operator [](std::string_view key)
+    {
+        auto it = lower_bound(key);
+        if ((it == entries.end()) || (it->first != key))
+        {
+            it = entries.emplace(it, std::string(key), Value{});
+        }
+
+        return it->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        return entries.erase(it);
+    }
+
+  private:
+    std::vector<value_type> entries;
+
+    iterator lower_bound(std::string_view key)
+    {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+            [] (const value_type& entry, std::string_view key)
+        {
+            return std::string_view{entry.first} < key;
+        });
+    }
+};
+}
+}
@@ -5,6 +5,7 @@
 #include <map>
 #include <chrono>
 #include <iomanip>
+#include <mutex>
 
 template<>
 std::string wf::log::to_string<void*>(void *arg)
@@ -159,6 +160,10 @@ void wf::log::log_plain(log_level_t level, const std::string& contents,
             "[", strip_path(source), ":", line_nr, "] ");
     }
 
+    /* Messages may be logged from multiple threads, for ex. when loading XML
+     * files in parallel. */
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
     state.out.get() <<
         wf::log::detail::format_concat(
         get_level_prefix(level), " ",
@@ -2,8 +2,11 @@
 
 #include <wayfire/config/compound-option.hpp>
 #include <wayfire/config/section.hpp>
+#include <wayfire/config/update-dispatcher.hpp>
+#include <wayfire/config/xml.hpp>
 #include <wayfire/nonstd/safe-list.hpp>
 #include <libxml/tree.h>
+#include <atomic>
 #include <stdint.h>
 
 namespace wf
@@ -20,20 +23,61 @@ namespace config
  */
 void update_compound_from_section(compound_option_t& option,
     const std::shared_ptr<section_t>& section);
+
+struct dispatched_handler_t;
+struct deferred_notifications_t;
 }
 }
 
+/** An update handler which is run by an update dispatcher. */
+struct wf::config::dispatched_handler_t
+{
+    option_base_t::updated_callback_t *callback;
+    update_dispatcher_t *dispatcher;
+
+    // Set when the handler is unregistered, on the thread which modifies the
+    // option, and read on the thread which runs the dispatcher.
+    std::atomic<bool> removed{false};
+
+    // Is the handler waiting in the queue of the dispatcher?
+    std::atomic<bool> queued{false};
+};
+
 struct wf::config::option_base_t::impl
 {
     std::string name;
     wf::safe_list_t<updated_callback_t*> updated_handlers;
+    wf::safe_list_t<std::shared_ptr<dispatched_handler_t>> dispatched_handlers;
+
+    /** Run the direct update handlers and queue the dispatched ones. */
+    void deliver_notifications();
 
     // Number of times the option has been locked
     int32_t lock_count = 0;
 
+    // Incremented whenever the value, the default value or the lock state of
+    // the option changes
+    uint64_t generation = 0;
+
+    // The notification batch which holds a notification for the option, if any.
+    // Written under the lock of the batches, see option.cpp.
+    std::atomic<deferred_notifications_t*> pending_in{nullptr};
+
     // Associated XML node
     xmlNode *xml = nullptr;
 
+    // Was the option declared in an XML file? The XML node is not available
+    // for options created from the schema cache.
+    bool from_xml = false;
+
+    // Metadata of the XML element which declared the option
+    std::shared_ptr<const xml::metadata_node_t> metadata;
+
+    bool is_from_xml() const
+    {
+        return xml || from_xml;
+    }
+
     // Is option in config file?
     bool option_in_config_file = false;
 
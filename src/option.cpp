@@ -1,5 +1,7 @@
 #include <wayfire/config/option.hpp>
 #include <algorithm>
+#include <exception>
+#include <mutex>
 #include <vector>
 
 #include "option-impl.hpp"
@@ -16,10 +18,56 @@ void wf::config::option_base_t::add_updated_handler(
     this->priv->updated_handlers.push_back(callback);
 }
 
+void wf::config::option_base_t::add_updated_handler(
+    updated_callback_t *callback, update_dispatcher_t& dispatcher)
+{
+    auto handler = std::make_shared<dispatched_handler_t>();
+    handler->callback   = callback;
+    handler->dispatcher = &dispatcher;
+    this->priv->dispatched_handlers.push_back(handler);
+}
+
 void wf::config::option_base_t::rem_updated_handler(
     updated_callback_t *callback)
 {
     priv->updated_handlers.remove_all(callback);
+    priv->dispatched_handlers.remove_if(
+        [=] (const std::shared_ptr<dispatched_handler_t>& handler)
+    {
+        if (handler->callback == callback)
+        {
+            handler->removed = true;
+            return true;
+        }
+
+        return false;
+    });
+}
+
+void wf::config::option_base_t::impl::deliver_notifications()
+{
+    updated_handlers.for_each([] (updated_callback_t *call)
+    {
+        (*call)();
+    });
+
+    dispatched_handlers.for_each([] (const std::shared_ptr<dispatched_handler_t>& handler)
+    {
+        if (handler->queued.exchange(true))
+        {
+            return;
+        }
+
+        handler->dispatcher->post([handler] ()
+        {
+            // Updates from now on need another run of the callback
+            handler->queued = false;
+            if (!handler->removed)
+            {
+                (*handler->callback)();
+            }
+        });
+    });
 }
 
 wf::config::option_base_t::option_base_t(const std::string& name)
@@ -28,19 +76,167 @@ wf::config::option_base_t::option_base_t(const std::string& name)
     this->priv->name = name;
 }
 
-wf::config::option_base_t::~option_base_t() = default;
+/**
+ * Notifications deferred by the active notification batches of a thread.
+ * Options are removed from the queue by setting their entry to nullptr, so
+ * that the queue can be safely modified while it is being delivered.
+ *
+ * An option may be destroyed on another thread than the one whose batch holds
+ * its notification, so the queues and the pending_in pointers of the options
+ * are modified under a lock shared by all threads. The lock is only taken
+ * while a batch is active.
+ */
+struct wf::config::deferred_notifications_t
+{
+    int batch_depth = 0;
+    bool delivering = false;
+    std::vector<const wf::config::option_base_t*> pending;
+
+    static std::mutex& get_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    ~deferred_notifications_t()
+    {
+        /* The thread exits with an open batch, the notifications are lost */
+        std::lock_guard<std::mutex> lock(get_mutex());
+        for (auto opt : pending)
+        {
+            if (opt)
+            {
+                opt->priv->pending_in = nullptr;
+            }
+        }
+    }
+};
+
+namespace
+{
+thread_local wf::config::deferred_notifications_t deferred;
+}
+
+wf::config::option_base_t::~option_base_t()
+{
+    if (priv->pending_in.load())
+    {
+        std::lock_guard<std::mutex> lock(deferred_notifications_t::get_mutex());
+        if (auto queue = priv->pending_in.load())
+        {
+            std::replace(queue->pending.begin(), queue->pending.end(),
+                (const option_base_t*)this, (const option_base_t*)nullptr);
+        }
+    }
+}
 
 void wf::config::option_base_t::notify_updated() const
 {
-    priv->updated_handlers.for_each([] (updated_callback_t *call)
+    ++priv->generation;
+    if (deferred.batch_depth > 0)
     {
-        (*call)();
-    });
+        std::lock_guard<std::mutex> lock(deferred_notifications_t::get_mutex());
+        if (!priv->pending_in.load())
+        {
+            priv->pending_in = &deferred;
+            deferred.pending.push_back(this);
+        }
+
+        return;
+    }
+
+    priv->deliver_notifications();
+}
+
+void wf::config::option_base_t::default_value_changed()
+{
+    ++priv->generation;
+}
+
+void wf::config::begin_notification_batch()
+{
+    ++deferred.batch_depth;
+}
+
+void wf::config::end_notification_batch()
+{
+    if (deferred.batch_depth <= 0)
+    {
+        LOGE("Ending a notification batch which was never started!");
+        return;
+    }
+
+    if ((--deferred.batch_depth > 0) || deferred.delivering)
+    {
+        return;
+    }
+
+    // Handlers may start new batches or destroy options, so the queue is
+    // re-checked on every iteration.
+    std::exception_ptr first_error;
+    auto& mutex = deferred_notifications_t::get_mutex();
+    deferred.delivering = true;
+    for (size_t i = 0;; i++)
+    {
+        const option_base_t *opt;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (i == deferred.pending.size())
+            {
+                deferred.pending.clear();
+                break;
+            }
+
+            opt = deferred.pending[i];
+            if (!opt)
+            {
+                continue;
+            }
+
+            deferred.pending[i] = nullptr;
+            opt->priv->pending_in = nullptr;
+        }
+
+        try {
+            opt->priv->deliver_notifications();
+        } catch (...)
+        {
+            if (!first_error)
+            {
+                first_error = std::current_exception();
+            }
+        }
+    }
+
+    deferred.delivering = false;
+    if (first_error)
+    {
+        std::rethrow_exception(first_error);
+    }
+}
+
+wf::config::notification_batch_t::notification_batch_t()
+{
+    begin_notification_batch();
+}
+
+wf::config::notification_batch_t::~notification_batch_t()
+{
+    try {
+        end_notification_batch();
+    } catch (const std::exception& e)
+    {
+        LOGE("An option update handler threw an exception: ", e.what());
+    } catch (...)
+    {
+        LOGE("An option update handler threw an exception");
+    }
 }
 
 void wf::config::option_base_t::set_locked(bool locked)
 {
     this->priv->lock_count += (locked ? 1 : -1);
+    ++this->priv->generation;
     if (priv->lock_count < 0)
     {
         LOGE("Lock counter for option ", this->get_name(), " dropped below zero!");
@@ -55,5 +251,7 @@ bool wf::config::option_base_t::is_locked() const
 void wf::config::option_base_t::init_clone(option_base_t& other) const
 {
     other.priv->xml  = this->priv->xml;
+    other.priv->from_xml = this->priv->from_xml;
+    other.priv->metadata = this->priv->metadata;
     other.priv->name = this->priv->name;
 }
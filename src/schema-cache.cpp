@@ -0,0 +1,480 @@
+#include "schema-cache.hpp"
+#include <wayfire/util/log.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char CACHE_MAGIC[] = "WFSCHEMA";
+/* Increment whenever the format or the meaning of the schema changes. */
+constexpr uint32_t CACHE_VERSION = 2;
+
+/* Minimum encoded sizes of the elements of arrays, used to check their counts
+ * against the remaining data before allocating them. */
+constexpr size_t MIN_STRING_SIZE   = sizeof(uint32_t);
+constexpr size_t MIN_OPTIONAL_SIZE = sizeof(uint8_t);
+constexpr size_t MIN_METADATA_SIZE = 2 * MIN_STRING_SIZE + 2 * sizeof(uint32_t);
+constexpr size_t MIN_ENTRY_SIZE    = 3 * MIN_STRING_SIZE + MIN_OPTIONAL_SIZE +
+    sizeof(int32_t);
+constexpr size_t MIN_OPTION_SIZE = 3 * MIN_STRING_SIZE + 3 * MIN_OPTIONAL_SIZE +
+    sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint8_t);
+constexpr size_t MIN_SECTION_SIZE = MIN_STRING_SIZE + sizeof(uint8_t) + sizeof(uint32_t);
+constexpr size_t MIN_FILE_SIZE    = MIN_STRING_SIZE + sizeof(uint64_t) +
+    2 * sizeof(int64_t) + sizeof(uint32_t);
+
+/* Metadata trees are read recursively. libxml2 does not parse documents which
+ * are nested deeper than this by default either. */
+constexpr int MAX_METADATA_DEPTH = 256;
+
+class cache_writer_t
+{
+  public:
+    std::string data;
+
+    template<class T>
+    void write_int(T value)
+    {
+        data.append((const char*)&value, sizeof(value));
+    }
+
+    void write_string(const std::string& str)
+    {
+        write_int<uint32_t>(str.size());
+        data.append(str);
+    }
+
+    void write_optional(const std::optional<std::string>& str)
+    {
+        write_int<uint8_t>(str.has_value());
+        if (str)
+        {
+            write_string(*str);
+        }
+    }
+};
+
+/** Reads the cache. Once an error occurs, all further reads fail. */
+class cache_reader_t
+{
+  public:
+    cache_reader_t(std::string_view data) : data(data)
+    {}
+
+    bool failed = false;
+
+    template<class T>
+    T read_int()
+    {
+        T value{};
+        if (failed || (data.size() < sizeof(T)))
+        {
+            failed = true;
+            return value;
+        }
+
+        memcpy(&value, data.data(), sizeof(T));
+        data.remove_prefix(sizeof(T));
+        return value;
+    }
+
+    std::string read_string()
+    {
+        uint32_t size = read_int<uint32_t>();
+        if (failed || (data.size() < size))
+        {
+            failed = true;
+            return {};
+        }
+
+        std::string result{data.substr(0, size)};
+        data.remove_prefix(size);
+        return result;
+    }
+
+    std::optional<std::string> read_optional()
+    {
+        if (read_int<uint8_t>())
+        {
+            return read_string();
+        }
+
+        return {};
+    }
+
+    /**
+     * Read the number of elements of an array, and check that the remaining
+     * data can hold that many elements of at least @min_element_size bytes.
+     */
+    uint32_t read_count(size_t min_element_size)
+    {
+        uint32_t count = read_int<uint32_t>();
+        if (count > data.size() / min_element_size)
+        {
+            failed = true;
+            return 0;
+        }
+
+        return count;
+    }
+
+    bool at_end() const
+    {
+        return data.empty();
+    }
+
+  private:
+    std::string_view data;
+};
+
+using metadata_node_t = wf::config::xml::metadata_node_t;
+
+void write_metadata(cache_writer_t& out, const metadata_node_t& node)
+{
+    out.write_string(node.name);
+    out.write_int<uint32_t>(node.attributes.size());
+    for (auto& [key, value] : node.attributes)
+    {
+        out.write_string(key);
+        out.write_string(value);
+    }
+
+    out.write_string(node.text);
+    out.write_int<uint32_t>(node.children.size());
+    for (auto& child : node.children)
+    {
+        write_metadata(out, child);
+    }
+}
+
+void read_metadata(cache_reader_t& in, metadata_node_t& node, int depth = 0)
+{
+    if (depth >= MAX_METADATA_DEPTH)
+    {
+        in.failed = true;
+        return;
+    }
+
+    node.name = in.read_string();
+    node.attributes.resize(in.read_count(2 * MIN_STRING_SIZE));
+    for (auto& [key, value] : node.attributes)
+    {
+        key   = in.read_string();
+        value = in.read_string();
+    }
+
+    node.text = in.read_string();
+    node.children.resize(in.read_count(MIN_METADATA_SIZE));
+    for (auto& child : node.children)
+    {
+        read_metadata(in, child, depth + 1);
+    }
+}
+
+/**
+ * Find the path of child indices from @root to @target.
+ * @return Whether @target is in the tree of @root.
+ */
+bool find_metadata_path(const metadata_node_t& root, const metadata_node_t *target,
+    std::vector<uint32_t>& path)
+{
+    if (&root == target)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < root.children.size(); i++)
+    {
+        path.push_back(i);
+        if (find_metadata_path(root.children[i], target, path))
+        {
+            return true;
+        }
+
+        path.pop_back();
+    }
+
+    return false;
+}
+
+/**
+ * The metadata of an option points into the metadata of its section, so it is
+ * stored as a path in the section's metadata tree.
+ */
+void write_option_metadata(cache_writer_t& out,
+    const wf::config::xml::section_schema_t& section,
+    const wf::config::xml::option_schema_t& option)
+{
+    std::vector<uint32_t> path;
+    bool found = section.metadata && option.metadata &&
+        find_metadata_path(*section.metadata, option.metadata.get(), path);
+
+    out.write_int<uint8_t>(found);
+    if (found)
+    {
+        out.write_int<uint32_t>(path.size());
+        for (auto idx : path)
+        {
+            out.write_int<uint32_t>(idx);
+        }
+    }
+}
+
+void read_option_metadata(cache_reader_t& in,
+    const wf::config::xml::section_schema_t& section,
+    wf::config::xml::option_schema_t& option)
+{
+    if (!in.read_int<uint8_t>())
+    {
+        return;
+    }
+
+    const metadata_node_t *node = section.metadata.get();
+    uint32_t length = in.read_count(sizeof(uint32_t));
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint32_t idx = in.read_int<uint32_t>();
+        if (!node || (idx >= node->children.size()))
+        {
+            in.failed = true;
+            return;
+        }
+
+        node = &node->children[idx];
+    }
+
+    if (node)
+    {
+        option.metadata = std::shared_ptr<const metadata_node_t>(section.metadata, node);
+    }
+}
+
+void write_option(cache_writer_t& out, const wf::config::xml::option_schema_t& option)
+{
+    out.write_string(option.name);
+    out.write_string(option.type);
+    out.write_optional(option.default_value);
+    out.write_optional(option.min);
+    out.write_optional(option.max);
+    out.write_int<int32_t>(option.line);
+    out.write_string(option.type_hint);
+    out.write_int<uint32_t>(option.entries.size());
+    for (auto& entry : option.entries)
+    {
+        out.write_string(entry.prefix);
+        out.write_string(entry.type);
+        out.write_string(entry.name);
+        out.write_optional(entry.default_value);
+        out.write_int<int32_t>(entry.line);
+    }
+}
+
+wf::config::xml::option_schema_t read_option(cache_reader_t& in)
+{
+    wf::config::xml::option_schema_t option;
+    option.name = in.read_string();
+    option.type = in.read_string();
+    option.default_value = in.read_optional();
+    option.min  = in.read_optional();
+    option.max  = in.read_optional();
+    option.line = in.read_int<int32_t>();
+    option.type_hint = in.read_string();
+    option.entries.resize(in.read_count(MIN_ENTRY_SIZE));
+    for (auto& entry : option.entries)
+    {
+        entry.prefix = in.read_string();
+        entry.type   = in.read_string();
+        entry.name   = in.read_string();
+        entry.default_value = in.read_optional();
+        entry.line = in.read_int<int32_t>();
+    }
+
+    return option;
+}
+}
+
+wf::config::schema_cache_t::schema_cache_t(const std::string& path) : path(path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+    {
+        return;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+
+    cache_reader_t in{contents};
+    if (contents.compare(0, sizeof(CACHE_MAGIC) - 1, CACHE_MAGIC) != 0)
+    {
+        LOGW("Ignoring invalid XML schema cache ", path);
+        return;
+    }
+
+    in.read_int<uint64_t>(); // magic
+    if (in.read_int<uint32_t>() != CACHE_VERSION)
+    {
+        LOGD("Ignoring XML schema cache ", path, " from a different version");
+        return;
+    }
+
+    std::map<std::string, entry_t> loaded;
+    uint32_t file_count = in.read_count(MIN_FILE_SIZE);
+    for (uint32_t i = 0; (i < file_count) && !in.failed; i++)
+    {
+        auto name = in.read_string();
+        auto& entry = loaded[name];
+        entry.size = in.read_int<uint64_t>();
+        entry.mtime_sec  = in.read_int<int64_t>();
+        entry.mtime_nsec = in.read_int<int64_t>();
+        entry.sections.resize(in.read_count(MIN_SECTION_SIZE));
+        for (auto& section : entry.sections)
+        {
+            section.name = in.read_string();
+            if (in.read_int<uint8_t>())
+            {
+                auto metadata = std::make_shared<metadata_node_t>();
+                read_metadata(in, *metadata);
+                section.metadata = std::move(metadata);
+            }
+
+            uint32_t option_count = in.read_count(MIN_OPTION_SIZE);
+            for (uint32_t j = 0; (j < option_count) && !in.failed; j++)
+            {
+                section.options.push_back(read_option(in));
+                read_option_metadata(in, section, section.options.back());
+            }
+        }
+    }
+
+    if (in.failed || !in.at_end())
+    {
+        LOGW("Ignoring corrupted XML schema cache ", path);
+        return;
+    }
+
+    entries = std::move(loaded);
+}
+
+const std::vector<wf::config::xml::section_schema_t> *wf::config::schema_cache_t::find(
+    const std::string& file, const struct stat& st)
+{
+    auto it = entries.find(file);
+    if ((it == entries.end()) || (it->second.size != (uint64_t)st.st_size) ||
+        (it->second.mtime_sec != st.st_mtim.tv_sec) ||
+        (it->second.mtime_nsec != st.st_mtim.tv_nsec))
+    {
+        return nullptr;
+    }
+
+    it->second.used = true;
+    return &it->second.sections;
+}
+
+void wf::config::schema_cache_t::store(const std::string& file,
+    const struct stat& st, const std::vector<xml::section_schema_t>& sections)
+{
+    auto& entry = entries[file];
+    entry.size = st.st_size;
+    entry.mtime_sec  = st.st_mtim.tv_sec;
+    entry.mtime_nsec = st.st_mtim.tv_nsec;
+    entry.sections   = sections;
+    entry.used = true;
+
+    /* The XML nodes will not be available when loading from the cache */
+    for (auto& section : entry.sections)
+    {
+        section.clear_xml_nodes();
+    }
+
+    dirty = true;
+}
+
+void wf::config::schema_cache_t::save()
+{
+    /* Other programs may share the cache with different XML directories, so
+     * only the entries of files which no longer exist are dropped. */
+    struct stat st;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (!it->second.used && (stat(it->first.c_str(), &st) != 0) && (errno == ENOENT))
+        {
+            it    = entries.erase(it);
+            dirty = true;
+        } else
+        {
+            ++it;
+        }
+    }
+
+    if (!dirty)
+    {
+        return;
+    }
+
+    cache_writer_t out;
+    out.data.append(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1);
+    out.write_int<uint32_t>(CACHE_VERSION);
+    out.write_int<uint32_t>(entries.size());
+    for (auto& [name, entry] : entries)
+    {
+        out.write_string(name);
+        out.write_int<uint64_t>(entry.size);
+        out.write_int<int64_t>(entry.mtime_sec);
+        out.write_int<int64_t>(entry.mtime_nsec);
+        out.write_int<uint32_t>(entry.sections.size());
+        for (auto& section : entry.sections)
+        {
+            out.write_string(section.name);
+            out.write_int<uint8_t>(section.metadata != nullptr);
+            if (section.metadata)
+            {
+                write_metadata(out, *section.metadata);
+            }
+
+            out.write_int<uint32_t>(section.options.size());
+            for (auto& option : section.options)
+            {
+                write_option(out, option);
+                write_option_metadata(out, section, option);
+            }
+        }
+    }
+
+    /* Replace the cache atomically, so that concurrent readers never see a
+     * partially written cache. */
+    std::string tmp_name = path + ".XXXXXX";
+    int fd = mkostemp(tmp_name.data(), O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOGW("Failed to write XML schema cache ", path, ": ", strerror(errno));
+        return;
+    }
+
+    std::string_view data = out.data;
+    while (!data.empty())
+    {
+        ssize_t written = write(fd, data.data(), data.size());
+        if ((written < 0) && (errno != EINTR))
+        {
+            break;
+        } else if (written > 0)
+        {
+            data.remove_prefix(written);
+        }
+    }
+
+    close(fd);
+    if (!data.empty() || (rename(tmp_name.c_str(), path.c_str()) != 0))
+    {
+        LOGW("Failed to write XML schema cache ", path, ": ", strerror(errno));
+        unlink(tmp_name.c_str());
+        return;
+    }
+
+    dirty = false;
+}
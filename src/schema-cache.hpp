@@ -0,0 +1,65 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "xml-impl.hpp"
+
+namespace wf
+{
+namespace config
+{
+/**
+ * An on-disk cache of the schemas declared in XML files, so that unchanged XML
+ * files do not have to be parsed again.
+ *
+ * Entries are keyed by the path of the XML file, and are valid as long as the
+ * size and the modification time of the file are unchanged. The cache file is
+ * a private binary format, and is ignored if it is missing, corrupted or was
+ * written by a different version of wf-config.
+ */
+class schema_cache_t
+{
+  public:
+    /** Load the cache from the given file. */
+    schema_cache_t(const std::string& path);
+
+    /**
+     * Find the cached schema of an XML file.
+     *
+     * @param st The result of stat() on the XML file.
+     * @return The cached sections, or nullptr if the cache entry is missing or
+     *   out of date.
+     */
+    const std::vector<xml::section_schema_t> *find(const std::string& file,
+        const struct stat& st);
+
+    /** Add or replace the schema of an XML file. */
+    void store(const std::string& file, const struct stat& st,
+        const std::vector<xml::section_schema_t>& sections);
+
+    /**
+     * Write the cache back to disk, if it has changed. Entries for files which
+     * were neither looked up nor stored since the cache was loaded are dropped
+     * if the files no longer exist.
+     */
+    void save();
+
+  private:
+    struct entry_t
+    {
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        std::vector<xml::section_schema_t> sections;
+        bool used = false;
+    };
+
+    std::string path;
+    std::map<std::string, entry_t> entries;
+    bool dirty = false;
+};
+}
+}
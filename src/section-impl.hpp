@@ -1,15 +1,46 @@
 #pragma once
 
 #include <wayfire/config/section.hpp>
+#include <wayfire/config/xml.hpp>
 #include <libxml/tree.h>
-#include <map>
+#include <atomic>
+
+#include "flat-map.hpp"
 
 struct wf::config::section_t::impl
 {
   public:
-    std::map<std::string, std::shared_ptr<option_base_t>> options;
+    // Sorted by name and contiguous, so that passes over all options of a
+    // section are cache-friendly.
+    flat_map_t<std::shared_ptr<option_base_t>> options;
     std::string name;
 
     // Associated XML node
     xmlNode *xml = NULL;
+
+    // Metadata of the XML element which declared the section
+    std::shared_ptr<const xml::metadata_node_t> metadata;
+
+    // Incremented whenever an option is registered or unregistered
+    uint64_t generation = 0;
+
+    // Incremented whenever an option is registered or unregistered in any
+    // section. Sections are built on several threads when XML files are
+    // loaded in parallel, so it is atomic. It only tells the binding index
+    // whether it has to check the generations of the sections, so changes in
+    // the sections of other config managers merely cause such a check.
+    static std::atomic<uint64_t> global_generation;
+
+    // State of the section when it was last loaded from a config source, used
+    // to skip unchanged sections when reloading.
+    struct
+    {
+        bool valid = false;
+        // Fingerprint of the section's lines in the config source
+        uint64_t fingerprint = 0;
+        // Value of generation after loading
+        uint64_t generation  = 0;
+        // Sum of the generations of all options after loading
+        uint64_t option_generations = 0;
+    } last_load;
 };
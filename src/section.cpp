@@ -1,6 +1,8 @@
 #include <stdexcept>
 #include "section-impl.hpp"
 
+std::atomic<uint64_t> wf::config::section_t::impl::global_generation{0};
+
 wf::config::section_t::section_t(const std::string& name)
 {
     this->priv = std::make_unique<impl>();
@@ -24,27 +26,29 @@ std::shared_ptr<wf::config::section_t> wf::config::section_t::clone_with_name(
     }
 
     result->priv->xml = this->priv->xml;
+    result->priv->metadata = this->priv->metadata;
     return result;
 }
 
 std::shared_ptr<wf::config::option_base_t> wf::config::section_t::get_option_or(
-    const std::string& name)
+    std::string_view name)
 {
-    if (this->priv->options.count(name))
+    auto it = this->priv->options.find(name);
+    if (it != this->priv->options.end())
     {
-        return this->priv->options[name];
+        return it->second;
     }
 
     return nullptr;
 }
 
 std::shared_ptr<wf::config::option_base_t> wf::config::section_t::get_option(
-    const std::string& name)
+    std::string_view name)
 {
     auto option = get_option_or(name);
     if (!option)
     {
-        throw std::invalid_argument("Non-existing option " + name +
+        throw std::invalid_argument("Non-existing option " + std::string(name) +
             " in config section " + this->get_name());
     }
 
@@ -63,6 +67,15 @@ const
     return list;
 }
 
+void wf::config::section_t::for_each_option(
+    const std::function<void(const std::shared_ptr<option_base_t>&)>& callback) const
+{
+    for (auto& option : priv->options)
+    {
+        callback(option.second);
+    }
+}
+
 void wf::config::section_t::register_new_option(
     std::shared_ptr<option_base_t> option)
 {
@@ -73,6 +86,8 @@ void wf::config::section_t::register_new_option(
     }
 
     this->priv->options[option->get_name()] = option;
+    ++this->priv->generation;
+    impl::global_generation.fetch_add(1, std::memory_order_relaxed);
 }
 
 void wf::config::section_t::unregister_option(
@@ -87,5 +102,7 @@ void wf::config::section_t::unregister_option(
     if ((it != this->priv->options.end()) && (it->second == option))
     {
         this->priv->options.erase(it);
+        ++this->priv->generation;
+        impl::global_generation.fetch_add(1, std::memory_order_relaxed);
     }
 }
@@ -0,0 +1,64 @@
+#include <wayfire/config/type-registry.hpp>
+#include <wayfire/config/types.hpp>
+#include <wayfire/util/duration.hpp>
+#include <wayfire/util/log.hpp>
+#include <unordered_map>
+
+using option_type_map_t =
+    std::unordered_map<std::string, wf::config::option_type_info_t>;
+
+static option_type_map_t make_builtin_option_types()
+{
+    using namespace wf::config;
+    return {
+        {"int", make_option_type_info<int>()},
+        {"double", make_option_type_info<double>()},
+        {"bool", make_option_type_info<bool>()},
+        {"string", make_option_type_info<std::string>()},
+        {"key", make_option_type_info<wf::keybinding_t>()},
+        {"button", make_option_type_info<wf::buttonbinding_t>()},
+        {"gesture", make_option_type_info<wf::touchgesture_t>()},
+        {"color", make_option_type_info<wf::color_t>()},
+        {"activator", make_option_type_info<wf::activatorbinding_t>()},
+        {"output::mode", make_option_type_info<wf::output_config::mode_t>()},
+        {"output::position", make_option_type_info<wf::output_config::position_t>()},
+        {"animation", make_option_type_info<wf::animation_description_t>()},
+    };
+}
+
+static option_type_map_t& get_option_types()
+{
+    static option_type_map_t types = make_builtin_option_types();
+    return types;
+}
+
+static bool is_builtin_option_type(const std::string& name)
+{
+    static const option_type_map_t builtin = make_builtin_option_types();
+    return builtin.count(name);
+}
+
+void wf::config::register_option_type(const std::string& name,
+    option_type_info_t info)
+{
+    if (name == "dynamic-list")
+    {
+        LOGE("Cannot register option type \"", name, "\": the name is reserved");
+        return;
+    }
+
+    if (is_builtin_option_type(name))
+    {
+        LOGI("Replacing built-in option type \"", name, "\"");
+    }
+
+    get_option_types()[name] = std::move(info);
+}
+
+const wf::config::option_type_info_t *wf::config::find_option_type(
+    const std::string& name)
+{
+    auto& types = get_option_types();
+    auto it     = types.find(name);
+    return (it == types.end()) ? nullptr : &it->second;
+}
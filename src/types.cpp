@@ -4,8 +4,10 @@
 #include <cmath>
 #include <algorithm>
 
-#include <libevdev/libevdev.h>
 #include <sstream>
+#include <string_view>
+
+#include "evdev-names.hpp"
 
 /* --------------------------- Primitive types ------------------------------ */
 template<>
@@ -278,14 +280,31 @@ static std::vector<std::string> split_at(std::string value, std::string at,
     return tokens;
 }
 
-static std::map<std::string, wf::keyboard_modifier_t> modifier_names =
+/* Sorted by name, which is the order in which they are written by
+ * binding_to_string(). There are few enough of them that a linear search is
+ * faster than any map. */
+static const std::pair<std::string_view, wf::keyboard_modifier_t> modifier_names[] =
 {
-    {"ctrl", wf::KEYBOARD_MODIFIER_CTRL},
     {"alt", wf::KEYBOARD_MODIFIER_ALT},
+    {"ctrl", wf::KEYBOARD_MODIFIER_CTRL},
     {"shift", wf::KEYBOARD_MODIFIER_SHIFT},
     {"super", wf::KEYBOARD_MODIFIER_LOGO},
 };
 
+/** @return The modifier with the given name, or 0 if there is none. */
+static uint32_t find_modifier(std::string_view name)
+{
+    for (auto& pair : modifier_names)
+    {
+        if (pair.first == name)
+        {
+            return pair.second;
+        }
+    }
+
+    return 0;
+}
+
 static std::string binding_to_string(general_binding_t binding)
 {
     std::string result = "";
@@ -293,13 +312,16 @@ static std::string binding_to_string(general_binding_t binding)
     {
         if (binding.mods & pair.second)
         {
-            result += "<" + pair.first + "> ";
+            result += "<";
+            result += pair.first;
+            result += "> ";
         }
     }
 
     if (binding.value > 0)
     {
-        auto evdev_name = libevdev_event_code_get_name(EV_KEY, binding.value);
+        auto evdev_name =
+            wf::config::evdev_names_t::get().name_from_code(binding.value);
         result += evdev_name ?: "NULL";
     }
 
@@ -353,23 +375,23 @@ static std::optional<general_binding_t> parse_binding(
     general_binding_t result = {true, 0, 0};
     for (size_t i = 0; i < tokens.size() - 1; i++)
     {
-        if (modifier_names.count(tokens[i]))
+        if (auto mod = find_modifier(tokens[i]))
         {
-            result.mods |= modifier_names[tokens[i]];
+            result.mods |= mod;
         } else
         {
             return {}; // invalid modifier
         }
     }
 
-    int code = libevdev_event_code_from_name(EV_KEY, tokens.back().c_str());
+    int code = wf::config::evdev_names_t::get().code_from_name(tokens.back());
     if (code == -1)
     {
         /* Last token might either be yet another modifier (in case of modifier
          * bindings) or it may be KEY_*. If neither, we have invalid binding */
-        if (modifier_names.count(tokens.back()))
+        if (auto mod = find_modifier(tokens.back()))
         {
-            result.mods |= modifier_names[tokens.back()];
+            result.mods |= mod;
             code = 0;
         } else
         {
@@ -930,6 +952,21 @@ const
     return priv->hotspots;
 }
 
+const std::vector<wf::keybinding_t>& wf::activatorbinding_t::get_keys() const
+{
+    return priv->keys;
+}
+
+const std::vector<wf::buttonbinding_t>& wf::activatorbinding_t::get_buttons() const
+{
+    return priv->buttons;
+}
+
+const std::vector<wf::touchgesture_t>& wf::activatorbinding_t::get_gestures() const
+{
+    return priv->gestures;
+}
+
 wf::hotspot_binding_t::hotspot_binding_t(uint32_t edges,
     int32_t along_edge, int32_t away_from_edge, int32_t timeout)
 {
@@ -0,0 +1,117 @@
+#include <wayfire/config/update-dispatcher.hpp>
+#include <wayfire/util/log.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+struct queued_callback_t
+{
+    std::function<void()> callback;
+    queued_callback_t *next = nullptr;
+};
+}
+
+struct wf::config::update_dispatcher_t::impl
+{
+    int event_fd = -1;
+
+    // Multiple-producer single-consumer queue, stored as a stack of the
+    // callbacks in reverse order. Producers push with a CAS loop, and the
+    // consumer takes the whole stack at once, so nodes are never popped
+    // individually and the stack does not suffer from ABA.
+    std::atomic<queued_callback_t*> head{nullptr};
+
+    queued_callback_t *take_all()
+    {
+        auto node = head.exchange(nullptr, std::memory_order_acquire);
+
+        // Restore the posting order
+        queued_callback_t *reversed = nullptr;
+        while (node)
+        {
+            auto next = node->next;
+            node->next = reversed;
+            reversed   = node;
+            node = next;
+        }
+
+        return reversed;
+    }
+};
+
+wf::config::update_dispatcher_t::update_dispatcher_t()
+{
+    this->priv = std::make_unique<impl>();
+    priv->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (priv->event_fd < 0)
+    {
+        LOGE("Failed to create eventfd for update dispatcher: ", strerror(errno));
+    }
+}
+
+wf::config::update_dispatcher_t::~update_dispatcher_t()
+{
+    auto node = priv->take_all();
+    while (node)
+    {
+        auto next = node->next;
+        delete node;
+        node = next;
+    }
+
+    if (priv->event_fd >= 0)
+    {
+        close(priv->event_fd);
+    }
+}
+
+int wf::config::update_dispatcher_t::get_fd() const
+{
+    return priv->event_fd;
+}
+
+void wf::config::update_dispatcher_t::post(std::function<void()> callback)
+{
+    auto node = new queued_callback_t{std::move(callback)};
+    node->next = priv->head.load(std::memory_order_relaxed);
+    while (!priv->head.compare_exchange_weak(node->next, node,
+        std::memory_order_release, std::memory_order_relaxed))
+    {}
+
+    if (priv->event_fd >= 0)
+    {
+        uint64_t one = 1;
+        if (write(priv->event_fd, &one, sizeof(one)) < 0)
+        {
+            LOGE("Failed to wake up update dispatcher: ", strerror(errno));
+        }
+    }
+}
+
+void wf::config::update_dispatcher_t::dispatch()
+{
+    // Clear the eventfd before taking the queue, so that callbacks posted
+    // after this point wake up the event loop again.
+    if (priv->event_fd >= 0)
+    {
+        uint64_t count;
+        if (read(priv->event_fd, &count, sizeof(count)) < 0)
+        {
+            // EAGAIN, nothing to do
+        }
+    }
+
+    auto node = priv->take_all();
+    while (node)
+    {
+        auto next = node->next;
+        node->callback();
+        delete node;
+        node = next;
+    }
+}
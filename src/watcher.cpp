@@ -0,0 +1,302 @@
+#include <wayfire/config/watcher.hpp>
+#include <wayfire/util/log.hpp>
+#include <cerrno>
+#include <map>
+#include <vector>
+
+#include "file-impl.hpp"
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstring>
+#include <unistd.h>
+
+namespace
+{
+/** A file or a group of files in a watched directory. */
+struct watched_entry_t
+{
+    /** File name in the directory, empty for all XML files. */
+    std::string name;
+    uint32_t kind;
+};
+
+void split_path(const std::string& path, std::string& dir, std::string& name)
+{
+    auto slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+    {
+        dir  = ".";
+        name = path;
+    } else
+    {
+        dir  = (slash == 0) ? "/" : path.substr(0, slash);
+        name = path.substr(slash + 1);
+    }
+}
+
+bool is_xml_file(const std::string& name)
+{
+    return (name.length() > 4) && (name.rfind(".xml") == name.length() - 4);
+}
+}
+
+struct wf::config::config_watcher_t::impl
+{
+    config_manager_t *manager;
+    std::string sysconf;
+    std::string userconf;
+    int debounce_ms;
+
+    int epoll_fd   = -1;
+    int inotify_fd = -1;
+    int timer_fd   = -1;
+
+    std::map<int, std::vector<watched_entry_t>> watches;
+    std::map<std::string, int> watched_dirs;
+
+    uint32_t pending = 0;
+    reload_callback_t callback;
+
+    void add_watch(const std::string& dir, const std::string& name, uint32_t kind)
+    {
+        int wd;
+        if (watched_dirs.count(dir))
+        {
+            wd = watched_dirs[dir];
+        } else
+        {
+            // Watch directories rather than the files themselves, so that we
+            // also notice files which are created or replaced by renaming.
+            wd = inotify_add_watch(inotify_fd, dir.c_str(),
+                IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE |
+                IN_MOVED_FROM | IN_MOVED_TO);
+            if (wd < 0)
+            {
+                LOGW("Failed to watch directory ", dir, ": ", strerror(errno));
+                return;
+            }
+
+            watched_dirs[dir] = wd;
+        }
+
+        watches[wd].push_back({name, kind});
+    }
+
+    void add_file_watch(const std::string& file, uint32_t kind)
+    {
+        if (file.empty())
+        {
+            return;
+        }
+
+        std::string dir, name;
+        split_path(file, dir, name);
+        add_watch(dir, name, kind);
+
+        // Config files are often symlinks to a dotfiles repository
+        char resolved[PATH_MAX];
+        if (realpath(file.c_str(), resolved) && (file != resolved))
+        {
+            split_path(resolved, dir, name);
+            add_watch(dir, name, kind);
+        }
+    }
+
+    void arm_timer()
+    {
+        itimerspec spec = {};
+        spec.it_value.tv_sec  = debounce_ms / 1000;
+        spec.it_value.tv_nsec = (debounce_ms % 1000) * 1000000L;
+        if ((spec.it_value.tv_sec == 0) && (spec.it_value.tv_nsec == 0))
+        {
+            // A zero value would disarm the timer
+            spec.it_value.tv_nsec = 1;
+        }
+
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+
+    /** @return True if any of the events concerned a watched file. */
+    bool read_inotify_events()
+    {
+        bool relevant = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t len;
+        while ((len = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *ptr = buffer; ptr < buffer + len;)
+            {
+                auto event = (inotify_event*)ptr;
+                ptr += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    // Events have been lost, so any of the files may have changed
+                    for (auto& watch : watches)
+                    {
+                        for (auto& entry : watch.second)
+                        {
+                            pending |= entry.kind;
+                        }
+                    }
+
+                    relevant = true;
+                    continue;
+                }
+
+                auto it = watches.find(event->wd);
+                if ((it == watches.end()) || (event->len == 0))
+                {
+                    continue;
+                }
+
+                std::string name = event->name;
+                for (auto& entry : it->second)
+                {
+                    if (entry.name.empty() ? is_xml_file(name) : (entry.name == name))
+                    {
+                        pending |= entry.kind;
+                        relevant = true;
+                    }
+                }
+            }
+        }
+
+        return relevant;
+    }
+
+    /** @return True if the pending changes were processed. */
+    bool reload(config_change_set_t& changes)
+    {
+        // Deliver the notifications for all files at once, at the end
+        notification_batch_t batch;
+        if (pending & WATCH_SYSCONF)
+        {
+            override_defaults(*manager, sysconf);
+            // The user config has to be re-applied on top of the new defaults
+            pending |= WATCH_USERCONF;
+        }
+
+        if (!(pending & WATCH_USERCONF))
+        {
+            return true;
+        }
+
+        if (load_configuration_options_from_file(*manager, userconf, changes))
+        {
+            return true;
+        }
+
+        // The file exists but could not be loaded, so most likely a writer
+        // holds the lock. Try again later.
+        struct stat st;
+        return stat(userconf.c_str(), &st) != 0;
+    }
+
+    void process_pending()
+    {
+        if (!pending)
+        {
+            return;
+        }
+
+        config_change_set_t changes;
+        if (!reload(changes))
+        {
+            // Defaults have already been applied, so do not apply them again.
+            pending &= ~WATCH_SYSCONF;
+            arm_timer();
+            return;
+        }
+
+        auto changed = pending;
+        pending = 0;
+        if (callback)
+        {
+            callback(changed, changes);
+        }
+    }
+};
+
+wf::config::config_watcher_t::config_watcher_t(config_manager_t& manager,
+    const std::vector<std::string>& xmldirs, const std::string& sysconf,
+    const std::string& userconf, int debounce_ms)
+{
+    this->priv = std::make_unique<impl>();
+    priv->manager     = &manager;
+    priv->sysconf     = sysconf;
+    priv->userconf    = userconf;
+    priv->debounce_ms = debounce_ms;
+
+    priv->epoll_fd   = epoll_create1(EPOLL_CLOEXEC);
+    priv->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    priv->timer_fd   = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ((priv->epoll_fd < 0) || (priv->inotify_fd < 0) || (priv->timer_fd < 0))
+    {
+        LOGE("Failed to initialize config file watcher: ", strerror(errno));
+        return;
+    }
+
+    for (int fd : {priv->inotify_fd, priv->timer_fd})
+    {
+        epoll_event event = {};
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    priv->add_file_watch(userconf, WATCH_USERCONF);
+    priv->add_file_watch(sysconf, WATCH_SYSCONF);
+    for (auto& dir : xmldirs)
+    {
+        priv->add_watch(dir, "", WATCH_XML);
+    }
+}
+
+wf::config::config_watcher_t::~config_watcher_t()
+{
+    for (int fd : {priv->epoll_fd, priv->inotify_fd, priv->timer_fd})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+void wf::config::config_watcher_t::set_reload_callback(reload_callback_t callback)
+{
+    priv->callback = callback;
+}
+
+int wf::config::config_watcher_t::get_fd() const
+{
+    bool initialized = (priv->epoll_fd >= 0) && (priv->inotify_fd >= 0) &&
+        (priv->timer_fd >= 0);
+    return initialized ? priv->epoll_fd : -1;
+}
+
+void wf::config::config_watcher_t::dispatch()
+{
+    if (get_fd() < 0)
+    {
+        return;
+    }
+
+    if (priv->read_inotify_events())
+    {
+        // New changes restart the debounce interval
+        priv->arm_timer();
+        return;
+    }
+
+    uint64_t expirations = 0;
+    if (read(priv->timer_fd, &expirations, sizeof(expirations)) > 0)
+    {
+        priv->process_pending();
+    }
+}
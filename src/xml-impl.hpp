@@ -0,0 +1,128 @@
+#pragma once
+
+#include <wayfire/config/xml.hpp>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+namespace config
+{
+namespace xml
+{
+/**
+ * The data needed to create an option, as declared in an XML file.
+ */
+struct option_schema_t
+{
+    /** A tuple entry of a dynamic-list option. */
+    struct entry_t
+    {
+        std::string prefix;
+        std::string type;
+        std::string name;
+        std::optional<std::string> default_value;
+        int line = 0;
+    };
+
+    std::string name;
+    std::string type;
+    std::optional<std::string> default_value;
+    std::optional<std::string> min;
+    std::optional<std::string> max;
+
+    /** Only used for dynamic-list options. */
+    std::string type_hint;
+    std::vector<entry_t> entries;
+
+    /** Line in the XML file, used for error messages. */
+    int line = 0;
+    /** The XML node, if it is still available. */
+    xmlNodePtr xml = nullptr;
+    /**
+     * The metadata of the option element. May be nullptr if the XML node is
+     * available, then the metadata is extracted from it when it is needed.
+     */
+    std::shared_ptr<const metadata_node_t> metadata;
+};
+
+/**
+ * The data needed to create a section and its options, as declared in an XML
+ * file.
+ */
+struct section_schema_t
+{
+    std::string name;
+    std::vector<option_schema_t> options;
+
+    /** The XML node, if it is still available. */
+    xmlNodePtr xml = nullptr;
+    /**
+     * The metadata of the section element, including all options. May be
+     * nullptr if the XML node is available, like the metadata of the options.
+     */
+    std::shared_ptr<const metadata_node_t> metadata;
+
+    /** Forget the XML nodes, for ex. before the XML document is freed. */
+    void clear_xml_nodes();
+};
+
+/**
+ * Create an owned copy of the given XML element and its children.
+ */
+metadata_node_t extract_metadata(xmlNodePtr node);
+
+/**
+ * Read the schema of an option from the given XML node.
+ * Errors are printed to the log.
+ *
+ * @param metadata The metadata of @node, if it has already been extracted.
+ *   Otherwise the schema has no metadata.
+ */
+std::optional<option_schema_t> extract_option_schema(xmlNodePtr node,
+    std::shared_ptr<const metadata_node_t> metadata = nullptr);
+
+/**
+ * Read the schema of a section and all its options from the given XML node.
+ * Options which contain errors are reported to the log and skipped.
+ *
+ * @param with_metadata Whether to extract the metadata of the section and its
+ *   options. Not needed as long as the XML nodes are kept.
+ */
+std::optional<section_schema_t> extract_section_schema(xmlNodePtr node,
+    bool with_metadata = true);
+
+/**
+ * Read the schemas of the sections declared in an XML file with the streaming
+ * reader of libxml2, in a single pass and without building the document tree.
+ *
+ * The schemas are the same as those from extract_section_schema() for each
+ * plugin/object element of the document, except that they have no XML nodes.
+ *
+ * @param on_section Called with each section as soon as its end is reached.
+ * @return Whether the whole file could be parsed. Sections may have been
+ *   reported before a parse error is encountered.
+ */
+bool read_section_schemas(const std::string& file,
+    const std::function<void(section_schema_t&&)>& on_section);
+
+/**
+ * Create an option from its schema.
+ * Errors are printed to the log.
+ *
+ * @param file The XML file the option was declared in, used for error messages.
+ * @return The new option, or nullptr if the schema is invalid.
+ */
+std::shared_ptr<option_base_t> create_option_from_schema(
+    const option_schema_t& schema, const std::string& file);
+
+/**
+ * Create a section and all valid options in it from its schema.
+ */
+std::shared_ptr<section_t> create_section_from_schema(
+    const section_schema_t& schema, const std::string& file);
+}
+}
+}
@@ -0,0 +1,462 @@
+#include <wayfire/util/log.hpp>
+#include <libxml/xmlreader.h>
+
+#include "xml-impl.hpp"
+
+namespace
+{
+using namespace wf::config::xml;
+
+/** The role of an element in the schema. */
+enum element_kind_t
+{
+    /* Not part of a schema, only recorded in the metadata. */
+    ELEMENT_IGNORED,
+    ELEMENT_SECTION,
+    /* A group or subgroup in a section, which can contain options. */
+    ELEMENT_GROUP,
+    ELEMENT_OPTION,
+    /* An entry of a dynamic-list option. */
+    ELEMENT_ENTRY,
+    /* The default, min or max value of an option or entry. */
+    ELEMENT_VALUE,
+};
+
+struct element_t
+{
+    element_kind_t kind;
+    /* The metadata of the element, or nullptr outside of sections. Only valid
+     * while the element is open, as siblings may be added later. */
+    metadata_node_t *metadata = nullptr;
+    /* Index of the element in the metadata of its parent. */
+    uint32_t index = 0;
+
+    /* For values: the number of child nodes, and the text of the first child
+     * if it is a text node. */
+    int child_count = 0;
+    std::optional<std::string> text;
+};
+
+/**
+ * Reads the schemas in an XML file in a single forward pass.
+ *
+ * The rules are the same as for the DOM-based extract_section_schema(): a value
+ * is the content of the last <default>/<min>/<max> child which is either empty
+ * or contains a single text node, and errors are reported with the same
+ * messages.
+ */
+class schema_reader_t
+{
+  public:
+    schema_reader_t(const std::string& file,
+        const std::function<void(section_schema_t&&)>& on_section) :
+        file(file), on_section(on_section)
+    {}
+
+    bool read()
+    {
+        reader = xmlReaderForFile(file.c_str(), NULL, 0);
+        if (!reader)
+        {
+            return false;
+        }
+
+        int ret;
+        while ((ret = xmlTextReaderRead(reader)) == 1)
+        {
+            switch (xmlTextReaderNodeType(reader))
+            {
+              case XML_READER_TYPE_ELEMENT:
+                start_element();
+                if (xmlTextReaderIsEmptyElement(reader))
+                {
+                    end_element();
+                }
+
+                break;
+
+              case XML_READER_TYPE_END_ELEMENT:
+                end_element();
+                break;
+
+              case XML_READER_TYPE_TEXT:
+              case XML_READER_TYPE_WHITESPACE:
+              case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+                add_child_node(true, false);
+                break;
+
+              case XML_READER_TYPE_CDATA:
+                add_child_node(false, true);
+                break;
+
+              default:
+                add_child_node(false, false);
+                break;
+            }
+        }
+
+        xmlFreeTextReader(reader);
+        return ret == 0;
+    }
+
+  private:
+    std::string file;
+    const std::function<void(section_schema_t&&)>& on_section;
+    xmlTextReaderPtr reader = nullptr;
+
+    /* The currently open elements */
+    std::vector<element_t> stack;
+
+    /* The section being read, and the paths of the option metadata in it */
+    section_schema_t section;
+    std::shared_ptr<metadata_node_t> section_metadata;
+    std::vector<std::vector<uint32_t>> option_paths;
+
+    /* The option being read. Options with errors are reset. */
+    std::optional<option_schema_t> option;
+
+    /** Register a non-element node as a child of the current element. */
+    void add_child_node(bool is_text, bool is_cdata)
+    {
+        if (stack.empty())
+        {
+            return;
+        }
+
+        auto& parent = stack.back();
+        if (parent.kind == ELEMENT_VALUE)
+        {
+            parent.child_count++;
+            if ((parent.child_count == 1) && is_text)
+            {
+                parent.text = get_value();
+            }
+        }
+
+        if (parent.metadata && (is_text || is_cdata))
+        {
+            parent.metadata->text += get_value();
+        }
+    }
+
+    std::string get_value()
+    {
+        auto value = xmlTextReaderConstValue(reader);
+        return value ? (const char*)value : "";
+    }
+
+    int get_line()
+    {
+        return xmlTextReaderCurrentNode(reader)->line;
+    }
+
+    void read_attributes(metadata_node_t& node)
+    {
+        while (xmlTextReaderMoveToNextAttribute(reader) == 1)
+        {
+            if (!xmlTextReaderIsNamespaceDecl(reader))
+            {
+                node.attributes.emplace_back(
+                    (const char*)xmlTextReaderConstLocalName(reader), get_value());
+            }
+        }
+
+        xmlTextReaderMoveToElement(reader);
+    }
+
+    void report_missing_attribute(const char *attribute)
+    {
+        LOGE("Could not parse ", file, ": XML node at line ", get_line(),
+            " is missing \"", attribute, "\" attribute.");
+    }
+
+    element_kind_t classify_element(const std::string& name)
+    {
+        if (stack.empty())
+        {
+            return ELEMENT_IGNORED; // The root element
+        }
+
+        switch (stack.back().kind)
+        {
+          case ELEMENT_IGNORED:
+            if ((stack.size() == 1) && ((name == "plugin") || (name == "object")))
+            {
+                return ELEMENT_SECTION;
+            }
+
+            return ELEMENT_IGNORED;
+
+          case ELEMENT_SECTION:
+          case ELEMENT_GROUP:
+            if (name == "option")
+            {
+                return ELEMENT_OPTION;
+            }
+
+            if ((name == "group") || (name == "subgroup"))
+            {
+                return ELEMENT_GROUP;
+            }
+
+            return ELEMENT_IGNORED;
+
+          case ELEMENT_OPTION:
+            if (!option)
+            {
+                return ELEMENT_IGNORED;
+            }
+
+            if (option->type == "dynamic-list")
+            {
+                return (name == "entry") ? ELEMENT_ENTRY : ELEMENT_IGNORED;
+            }
+
+            return ((name == "default") || (name == "min") || (name == "max")) ?
+                   ELEMENT_VALUE : ELEMENT_IGNORED;
+
+          case ELEMENT_ENTRY:
+            return (option && (name == "default")) ? ELEMENT_VALUE : ELEMENT_IGNORED;
+
+          case ELEMENT_VALUE:
+            return ELEMENT_IGNORED;
+        }
+
+        return ELEMENT_IGNORED;
+    }
+
+    void start_element()
+    {
+        std::string name = (const char*)xmlTextReaderConstLocalName(reader);
+        if (!stack.empty() && (stack.back().kind == ELEMENT_VALUE))
+        {
+            stack.back().child_count++;
+        }
+
+        element_t element;
+        element.kind = classify_element(name);
+
+        metadata_node_t *parent_metadata = stack.empty() ? nullptr : stack.back().metadata;
+        if (element.kind == ELEMENT_SECTION)
+        {
+            section_metadata = std::make_shared<metadata_node_t>();
+            element.metadata = section_metadata.get();
+        } else if (parent_metadata)
+        {
+            element.index    = parent_metadata->children.size();
+            element.metadata = &parent_metadata->children.emplace_back();
+        }
+
+        if (element.metadata)
+        {
+            element.metadata->name = name;
+            read_attributes(*element.metadata);
+        }
+
+        switch (element.kind)
+        {
+          case ELEMENT_SECTION:
+            start_section(element);
+            break;
+
+          case ELEMENT_OPTION:
+            start_option(element);
+            break;
+
+          case ELEMENT_ENTRY:
+            start_entry(element);
+            break;
+
+          default:
+            break;
+        }
+
+        stack.push_back(std::move(element));
+    }
+
+    void start_section(element_t& element)
+    {
+        section = {};
+        option_paths.clear();
+
+        auto name = element.metadata->get_attribute("name");
+        if (!name)
+        {
+            report_missing_attribute("name");
+            element.kind     = ELEMENT_IGNORED;
+            element.metadata = nullptr;
+            section_metadata.reset();
+            return;
+        }
+
+        section.name = *name;
+    }
+
+    void start_option(const element_t& element)
+    {
+        auto& metadata = *element.metadata;
+        auto name = metadata.get_attribute("name");
+        auto type = metadata.get_attribute("type");
+        if (!name || !type)
+        {
+            report_missing_attribute(name ? "type" : "name");
+            option.reset();
+            return;
+        }
+
+        option = option_schema_t{};
+        option->name = *name;
+        option->type = *type;
+        option->line = get_line();
+        if (*type == "dynamic-list")
+        {
+            auto type_hint = metadata.get_attribute("type-hint").value_or("");
+            option->type_hint = type_hint.empty() ? "dict" : type_hint;
+        }
+    }
+
+    void start_entry(element_t& element)
+    {
+        auto& metadata = *element.metadata;
+        auto prefix = metadata.get_attribute("prefix");
+        auto type   = metadata.get_attribute("type");
+        if (!prefix || !type)
+        {
+            report_missing_attribute(prefix ? "type" : "prefix");
+            option.reset();
+            element.kind = ELEMENT_IGNORED;
+            return;
+        }
+
+        option->entries.push_back({*prefix, *type,
+            metadata.get_attribute("name").value_or(""), {}, get_line()});
+    }
+
+    void end_element()
+    {
+        element_t element = std::move(stack.back());
+        stack.pop_back();
+
+        if (element.metadata && !element.metadata->children.empty() &&
+            (element.metadata->text.find_first_not_of(" \t\r\n") == std::string::npos))
+        {
+            element.metadata->text.clear();
+        }
+
+        switch (element.kind)
+        {
+          case ELEMENT_SECTION:
+            end_section();
+            break;
+
+          case ELEMENT_OPTION:
+            end_option(element);
+            break;
+
+          case ELEMENT_VALUE:
+            end_value(element);
+            break;
+
+          default:
+            break;
+        }
+    }
+
+    void end_value(const element_t& element)
+    {
+        std::optional<std::string> value;
+        if (element.child_count == 0)
+        {
+            value = "";
+        } else if (element.child_count == 1)
+        {
+            value = element.text;
+        }
+
+        if (!value || !option)
+        {
+            return;
+        }
+
+        if (stack.back().kind == ELEMENT_ENTRY)
+        {
+            option->entries.back().default_value = value;
+            return;
+        }
+
+        auto& name = element.metadata->name;
+        if (name == "default")
+        {
+            option->default_value = value;
+        } else if (name == "min")
+        {
+            option->min = value;
+        } else
+        {
+            option->max = value;
+        }
+    }
+
+    void end_option(const element_t& element)
+    {
+        if (!option)
+        {
+            return;
+        }
+
+        if ((option->type != "dynamic-list") && !option->default_value)
+        {
+            LOGE("Could not parse ", file,
+                ": option at line ", option->line, " has no default value specified.");
+            option.reset();
+            return;
+        }
+
+        /* The path of the option's metadata, starting below the section */
+        size_t i = stack.size();
+        while (stack[i - 1].kind != ELEMENT_SECTION)
+        {
+            --i;
+        }
+
+        std::vector<uint32_t> path;
+        for (; i < stack.size(); i++)
+        {
+            path.push_back(stack[i].index);
+        }
+
+        path.push_back(element.index);
+
+        section.options.push_back(std::move(*option));
+        option_paths.push_back(std::move(path));
+        option.reset();
+    }
+
+    void end_section()
+    {
+        /* The metadata is complete, so pointers into it are now stable */
+        for (size_t i = 0; i < section.options.size(); i++)
+        {
+            const metadata_node_t *node = section_metadata.get();
+            for (auto idx : option_paths[i])
+            {
+                node = &node->children[idx];
+            }
+
+            section.options[i].metadata =
+                std::shared_ptr<const metadata_node_t>(section_metadata, node);
+        }
+
+        section.metadata = std::move(section_metadata);
+        on_section(std::move(section));
+        section = {};
+        option_paths.clear();
+    }
+};
+}
+
+bool wf::config::xml::read_section_schemas(const std::string& file,
+    const std::function<void(section_schema_t&&)>& on_section)
+{
+    return schema_reader_t{file, on_section}.read();
+}
@@ -2,9 +2,11 @@
 #include <wayfire/config/types.hpp>
 #include <wayfire/util/log.hpp>
 #include <wayfire/config/compound-option.hpp>
+#include <wayfire/config/type-registry.hpp>
 
 #include "section-impl.hpp"
 #include "option-impl.hpp"
+#include "xml-impl.hpp"
 #include "wayfire/util/duration.hpp"
 
 static std::optional<const xmlChar*> extract_value(xmlNodePtr node,
@@ -35,106 +37,45 @@ static std::optional<const xmlChar*> extract_value(xmlNodePtr node,
     return value_ptr;
 }
 
-/**
- * Create a new option of type T with the given name and default value.
- * @return The new option, or nullptr if the default value is invaild.
- */
-template<class T>
-std::shared_ptr<wf::config::option_t<T>> create_option(std::string name,
-    std::string default_value)
+static std::string get_document_url(xmlNodePtr node)
 {
-    auto value = wf::option_type::from_string<T>(default_value);
-    if (!value)
-    {
-        return {};
-    }
-
-    return std::make_shared<wf::config::option_t<T>>(name, value.value());
-}
-
-enum bounds_error_t
-{
-    BOUNDS_INVALID_MINIMUM,
-    BOUNDS_INVALID_MAXIMUM,
-    BOUNDS_OK,
-};
-
-template<class T>
-bounds_error_t set_bounds(
-    std::shared_ptr<wf::config::option_base_t>& option,
-    std::optional<const xmlChar*> min_ptr,
-    std::optional<const xmlChar*> max_ptr)
-{
-    if (!option)
-    {
-        return BOUNDS_OK; // there has been an earlier error
-    }
-
-    auto typed_option =
-        std::dynamic_pointer_cast<wf::config::option_t<T>>(option);
-    assert(typed_option);
-
-    if (min_ptr)
-    {
-        auto value = wf::option_type::from_string<T>(
-            (const char*)min_ptr.value());
-        if (value)
-        {
-            typed_option->set_minimum(value.value());
-        } else
-        {
-            return BOUNDS_INVALID_MINIMUM;
-        }
-    }
-
-    if (max_ptr)
-    {
-        std::optional<T> value = wf::option_type::from_string<T>(
-            (const char*)max_ptr.value());
-        if (value)
-        {
-            typed_option->set_maximum(value.value());
-        } else
-        {
-            return BOUNDS_INVALID_MAXIMUM;
-        }
-    }
-
-    return BOUNDS_OK;
+    return (node->doc && node->doc->URL) ? (const char*)node->doc->URL : "";
 }
 
 #define GET_XML_PROP_OR_BAIL(node, name, str) \
-    const char *name ## _ptr = (const char*)xmlGetProp(node, (const xmlChar*)(str)); \
+    xmlChar *name ## _ptr = xmlGetProp(node, (const xmlChar*)(str)); \
     if (!name ## _ptr) \
     { \
-        LOGE("Could not parse ", (node)->doc->URL, \
+        LOGE("Could not parse ", get_document_url(node), \
     ": XML node at line ", node->line, " is missing \"" #name "\" attribute."); \
-        return nullptr; \
+        return {}; \
     } \
-    std::string name = name ## _ptr;
+    std::string name = (const char*)name ## _ptr; \
+    xmlFree(name ## _ptr);
 
 #define GET_OPTIONAL_XML_PROP(node, name, str) \
-    const char *name ## _ptr = (const char*)xmlGetProp(node, (const xmlChar*)(str)); \
-    if (!name ## _ptr) \
-    { \
-        name ## _ptr = "";   \
-    } \
-    std::string name = name ## _ptr;
-
-template<class T>
-using entry_t = wf::config::compound_option_entry_t<T>;
+    xmlChar *name ## _ptr = xmlGetProp(node, (const xmlChar*)(str)); \
+    std::string name = name ## _ptr ? (const char*)name ## _ptr : ""; \
+    xmlFree(name ## _ptr);
 
-std::shared_ptr<wf::config::option_base_t> parse_compound_option(xmlNodePtr node,
-    const std::string& name)
+static std::optional<std::string> extract_string(xmlNodePtr node,
+    const std::string& value_name)
 {
-    wf::config::compound_option_t::entries_t entries;
-    GET_OPTIONAL_XML_PROP(node, type_hint, "type-hint");
-
-    if (type_hint.empty())
+    auto value = extract_value(node, value_name);
+    if (value)
     {
-        type_hint = "dict";
+        return std::string((const char*)value.value());
     }
 
+    return {};
+}
+
+static bool extract_dynamic_list(xmlNodePtr node,
+    wf::config::xml::option_schema_t& schema)
+{
+    GET_OPTIONAL_XML_PROP(node, type_hint, "type-hint");
+    schema.type_hint = type_hint.empty() ? "dict" : type_hint;
+
     node = node->children;
     while (node)
     {
@@ -145,245 +86,347 @@ std::shared_ptr<wf::config::option_base_t> parse_compound_option(xmlNodePtr node
             GET_XML_PROP_OR_BAIL(node, prefix, "prefix");
             GET_XML_PROP_OR_BAIL(node, type, "type");
             GET_OPTIONAL_XML_PROP(node, name, "name");
+            schema.entries.push_back({prefix, type, name,
+                extract_string(node, "default"), node->line});
+        }
 
-            std::optional<std::string> default_value = std::nullopt;
-            if (const auto& default_value_raw = extract_value(node, "default"))
-            {
-                default_value = (const char*)default_value_raw.value();
-            }
+        node = node->next;
+    }
 
-            if (type == "int")
-            {
-                entries.push_back(std::make_unique<entry_t<int>>(prefix, name,
-                    default_value));
-            } else if (type == "double")
-            {
-                entries.push_back(std::make_unique<entry_t<double>>(prefix, name,
-                    default_value));
-            } else if (type == "bool")
-            {
-                entries.push_back(std::make_unique<entry_t<bool>>(prefix, name,
-                    default_value));
-            } else if (type == "string")
-            {
-                entries.push_back(std::make_unique<entry_t<std::string>>(prefix,
-                    name, default_value));
-            } else if (type == "key")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::keybinding_t>>(prefix,
-                    name, default_value));
-            } else if (type == "button")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::buttonbinding_t>>(
-                    prefix, name, default_value));
-            } else if (type == "gesture")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::touchgesture_t>>(
-                    prefix, name, default_value));
-            } else if (type == "color")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::color_t>>(prefix,
-                    name, default_value));
-            } else if (type == "activator")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::activatorbinding_t>>(
-                    prefix, name, default_value));
-            } else if (type == "animation")
-            {
-                entries.push_back(std::make_unique<entry_t<wf::animation_description_t>>(
-                    prefix, name, default_value));
-            } else
-            {
-                LOGE("Could not parse ", node->doc->URL,
-                    ": option at line ", node->line,
-                    " has invalid type \"", type, "\"");
-                return nullptr;
-            }
+    return true;
+}
+
+static bool is_whitespace(const std::string& text)
+{
+    return text.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+wf::config::xml::metadata_node_t wf::config::xml::extract_metadata(xmlNodePtr node)
+{
+    metadata_node_t metadata;
+    metadata.name = (const char*)node->name;
+    for (auto attr = node->properties; attr != nullptr; attr = attr->next)
+    {
+        xmlChar *value = xmlNodeListGetString(node->doc, attr->children, 1);
+        metadata.attributes.emplace_back((const char*)attr->name,
+            value ? (const char*)value : "");
+        xmlFree(value);
+    }
+
+    for (auto child = node->children; child != nullptr; child = child->next)
+    {
+        if (child->type == XML_ELEMENT_NODE)
+        {
+            metadata.children.push_back(extract_metadata(child));
+        } else if (((child->type == XML_TEXT_NODE) ||
+                    (child->type == XML_CDATA_SECTION_NODE)) && child->content)
+        {
+            metadata.text += (const char*)child->content;
         }
+    }
 
-        node = node->next;
+    /* Drop the indentation between child elements */
+    if (!metadata.children.empty() && is_whitespace(metadata.text))
+    {
+        metadata.text.clear();
     }
 
-    auto opt =
-        new wf::config::compound_option_t{name, std::move(entries), type_hint};
-    return std::shared_ptr<wf::config::option_base_t>(opt);
+    return metadata;
 }
 
-std::shared_ptr<wf::config::option_base_t> wf::config::xml::create_option_from_xml_node(xmlNodePtr node)
+std::optional<std::string> wf::config::xml::metadata_node_t::get_attribute(
+    const std::string& attribute) const
+{
+    for (auto& [key, value] : attributes)
+    {
+        if (key == attribute)
+        {
+            return value;
+        }
+    }
+
+    return {};
+}
+
+const wf::config::xml::metadata_node_t *wf::config::xml::metadata_node_t::get_child(
+    const std::string& child) const
+{
+    for (auto& node : children)
+    {
+        if (node.name == child)
+        {
+            return &node;
+        }
+    }
+
+    return nullptr;
+}
+
+std::optional<wf::config::xml::option_schema_t> wf::config::xml::extract_option_schema(
+    xmlNodePtr node, std::shared_ptr<const metadata_node_t> metadata)
 {
     if ((node->type != XML_ELEMENT_NODE) ||
         ((const char*)node->name != std::string{"option"}))
     {
-        LOGE("Could not parse ", node->doc->URL,
+        LOGE("Could not parse ", get_document_url(node),
             ": line ", node->line, " is not an option element.");
-        return nullptr;
+        return {};
     }
 
     GET_XML_PROP_OR_BAIL(node, name, "name");
     GET_XML_PROP_OR_BAIL(node, type, "type");
+
+    option_schema_t schema;
+    schema.name = name;
+    schema.type = type;
+    schema.line = node->line;
+    schema.xml  = node;
+    schema.metadata = std::move(metadata);
+
     if (type == "dynamic-list")
     {
-        auto option = parse_compound_option(node, name);
-        if (option)
+        if (!extract_dynamic_list(node, schema))
         {
-            option->priv->xml = node;
+            return {};
         }
 
-        return option;
+        return schema;
     }
 
-    auto default_value_ptr = extract_value(node, "default");
-    if (!default_value_ptr)
+    schema.default_value = extract_string(node, "default");
+    if (!schema.default_value)
     {
-        LOGE("Could not parse ", node->doc->URL,
+        LOGE("Could not parse ", get_document_url(node),
             ": option at line ", node->line, " has no default value specified.");
-        return nullptr;
+        return {};
     }
 
-    std::string default_value = (const char*)default_value_ptr.value();
+    schema.min = extract_string(node, "min");
+    schema.max = extract_string(node, "max");
+    return schema;
+}
 
-    auto min_value_ptr = extract_value(node, "min");
-    auto max_value_ptr = extract_value(node, "max");
+static std::shared_ptr<wf::config::option_base_t> create_compound_option(
+    const wf::config::xml::option_schema_t& schema, const std::string& file)
+{
+    wf::config::compound_option_t::entries_t entries;
+    for (auto& entry : schema.entries)
+    {
+        auto type = wf::config::find_option_type(entry.type);
+        if (!type || !type->create_entry)
+        {
+            LOGE("Could not parse ", file,
+                ": option at line ", entry.line,
+                " has invalid type \"", entry.type, "\"");
+            return nullptr;
+        }
 
-    std::shared_ptr<wf::config::option_base_t> option;
-    bounds_error_t bounds_error = BOUNDS_OK;
+        entries.push_back(type->create_entry(entry.prefix, entry.name,
+            entry.default_value));
+    }
 
-    if (type == "int")
-    {
-        option = create_option<int>(name, default_value);
-        bounds_error = set_bounds<int>(option,
-            min_value_ptr, max_value_ptr);
-    } else if (type == "double")
-    {
-        option = create_option<double>(name, default_value);
-        bounds_error = set_bounds<double>(option,
-            min_value_ptr, max_value_ptr);
-    } else if (type == "bool")
-    {
-        option = create_option<bool>(name, default_value);
-    } else if (type == "string")
-    {
-        option = create_option<std::string>(name, default_value);
-    } else if (type == "key")
-    {
-        option = create_option<wf::keybinding_t>(name, default_value);
-    } else if (type == "button")
-    {
-        option = create_option<wf::buttonbinding_t>(name, default_value);
-    } else if (type == "gesture")
-    {
-        option = create_option<wf::touchgesture_t>(name, default_value);
-    } else if (type == "color")
-    {
-        option = create_option<wf::color_t>(name, default_value);
-    } else if (type == "activator")
-    {
-        option = create_option<wf::activatorbinding_t>(name, default_value);
-    } else if (type == "output::mode")
-    {
-        option = create_option<wf::output_config::mode_t>(name, default_value);
-    } else if (type == "output::position")
+    auto opt = new wf::config::compound_option_t{schema.name, std::move(entries),
+        schema.type_hint};
+    return std::shared_ptr<wf::config::option_base_t>(opt);
+}
+
+std::shared_ptr<wf::config::option_base_t> wf::config::xml::create_option_from_schema(
+    const option_schema_t& schema, const std::string& file)
+{
+    const auto& name = schema.name;
+    const auto& type = schema.type;
+    if (type == "dynamic-list")
     {
-        option = create_option<wf::output_config::position_t>(name, default_value);
-    } else if (type == "animation")
+        auto option = create_compound_option(schema, file);
+        if (option)
+        {
+            option->priv->xml = schema.xml;
+            option->priv->metadata = schema.metadata;
+            option->priv->from_xml = true;
+        }
+
+        return option;
+    }
+
+    if (!schema.default_value)
     {
-        option = create_option<wf::animation_description_t>(name, default_value);
-    } else
+        LOGE("Could not parse ", file,
+            ": option at line ", schema.line, " has no default value specified.");
+        return nullptr;
+    }
+
+    const std::string& default_value = schema.default_value.value();
+    const auto& min_value = schema.min;
+    const auto& max_value = schema.max;
+
+    auto option_type = wf::config::find_option_type(type);
+    if (!option_type || !option_type->create_option)
     {
-        LOGE("Could not parse ", node->doc->URL,
-            ": option at line ", node->line,
+        LOGE("Could not parse ", file,
+            ": option at line ", schema.line,
             " has invalid type \"", type, "\"");
         return nullptr;
     }
 
+    auto option = option_type->create_option(name, default_value);
     if (!option)
     {
         /* This can only happen if default value was invalid */
-        LOGE("Could not parse ", node->doc->URL,
-            ": option at line ", node->line,
+        LOGE("Could not parse ", file,
+            ": option at line ", schema.line,
             " has invalid default value \"", default_value, "\" for type ",
             type);
         return nullptr;
     }
 
-    switch (bounds_error)
+    if (min_value && option_type->set_minimum &&
+        !option_type->set_minimum(*option, min_value.value()))
     {
-      case BOUNDS_INVALID_MINIMUM:
-        assert(min_value_ptr);
-        LOGE("Could not parse ", node->doc->URL,
-            ": option at line ", node->line,
-            " has invalid minimum value \"", min_value_ptr.value(), "\"",
+        LOGE("Could not parse ", file,
+            ": option at line ", schema.line,
+            " has invalid minimum value \"", min_value.value(), "\"",
             "for type ", type);
         return nullptr;
+    }
 
-      case BOUNDS_INVALID_MAXIMUM:
-        assert(max_value_ptr);
-        LOGE("Could not parse ", node->doc->URL,
-            ": option at line ", node->line,
-            " has invalid maximum value \"", max_value_ptr.value(), "\"",
+    if (max_value && option_type->set_maximum &&
+        !option_type->set_maximum(*option, max_value.value()))
+    {
+        LOGE("Could not parse ", file,
+            ": option at line ", schema.line,
+            " has invalid maximum value \"", max_value.value(), "\"",
             "for type ", type);
         return nullptr;
-
-      default:
-        break;
     }
 
-    option->priv->xml = node;
+    option->priv->xml = schema.xml;
+    option->priv->metadata = schema.metadata;
+    option->priv->from_xml = true;
     return option;
 }
 
+std::shared_ptr<wf::config::option_base_t> wf::config::xml::create_option_from_xml_node(xmlNodePtr node)
+{
+    auto schema = extract_option_schema(node);
+    if (!schema)
+    {
+        return nullptr;
+    }
+
+    return create_option_from_schema(*schema, get_document_url(node));
+}
+
+/**
+ * Extract the options in the section element @node. @metadata is the metadata
+ * of @node, which is shared by the options with the section metadata @root,
+ * or nullptr if the metadata is not extracted.
+ */
 static void recursively_parse_section_node(xmlNodePtr node,
-    std::shared_ptr<wf::config::section_t> section)
+    wf::config::xml::section_schema_t& section,
+    const std::shared_ptr<const wf::config::xml::metadata_node_t>& root,
+    const wf::config::xml::metadata_node_t *metadata)
 {
-    auto child_ptr = node->children;
+    /* The metadata contains exactly the element children of the node */
+    size_t element_idx = 0;
+    auto child_ptr     = node->children;
     while (child_ptr != nullptr)
     {
-        if ((child_ptr->type == XML_ELEMENT_NODE) &&
-            (std::string((const char*)child_ptr->name) == "option"))
+        if (child_ptr->type != XML_ELEMENT_NODE)
         {
-            auto option = wf::config::xml::create_option_from_xml_node(
-                child_ptr);
+            child_ptr = child_ptr->next;
+            continue;
+        }
+
+        auto child_metadata = metadata ? &metadata->children[element_idx++] : nullptr;
+        if (std::string((const char*)child_ptr->name) == "option")
+        {
+            auto option = wf::config::xml::extract_option_schema(child_ptr,
+                child_metadata ? std::shared_ptr<const wf::config::xml::metadata_node_t>(
+                    root, child_metadata) : nullptr);
             if (option)
             {
-                section->register_new_option(option);
+                section.options.push_back(std::move(*option));
             }
         }
 
-        if ((child_ptr->type == XML_ELEMENT_NODE) &&
-            (std::string((const char*)child_ptr->name) == "group"))
+        if (std::string((const char*)child_ptr->name) == "group")
         {
-            recursively_parse_section_node(child_ptr, section);
+            recursively_parse_section_node(child_ptr, section, root, child_metadata);
         }
 
-        if ((child_ptr->type == XML_ELEMENT_NODE) &&
-            (std::string((const char*)child_ptr->name) == "subgroup"))
+        if (std::string((const char*)child_ptr->name) == "subgroup")
         {
-            recursively_parse_section_node(child_ptr, section);
+            recursively_parse_section_node(child_ptr, section, root, child_metadata);
         }
 
         child_ptr = child_ptr->next;
     }
 }
 
-std::shared_ptr<wf::config::section_t> wf::config::xml::create_section_from_xml_node(
-    xmlNodePtr node)
+std::optional<wf::config::xml::section_schema_t> wf::config::xml::extract_section_schema(
+    xmlNodePtr node, bool with_metadata)
 {
     if ((node->type != XML_ELEMENT_NODE) ||
         (((const char*)node->name != std::string{"plugin"}) &&
          ((const char*)node->name != std::string{"object"})))
     {
-        LOGE("Could not parse ", node->doc->URL,
+        LOGE("Could not parse ", get_document_url(node),
             ": line ", node->line, " is not a plugin/object element.");
-        return nullptr;
+        return {};
     }
 
     GET_XML_PROP_OR_BAIL(node, name, "name");
-    auto section = std::make_shared<section_t>(name);
-    section->priv->xml = node;
-    recursively_parse_section_node(node, section);
+    section_schema_t schema;
+    schema.name = name;
+    schema.xml  = node;
+    if (with_metadata)
+    {
+        schema.metadata = std::make_shared<const metadata_node_t>(extract_metadata(node));
+    }
+
+    recursively_parse_section_node(node, schema, schema.metadata, schema.metadata.get());
+    return schema;
+}
+
+void wf::config::xml::section_schema_t::clear_xml_nodes()
+{
+    xml = nullptr;
+    for (auto& option : options)
+    {
+        option.xml = nullptr;
+    }
+}
+
+std::shared_ptr<wf::config::section_t> wf::config::xml::create_section_from_schema(
+    const section_schema_t& schema, const std::string& file)
+{
+    auto section = std::make_shared<section_t>(schema.name);
+    section->priv->xml = schema.xml;
+    section->priv->metadata = schema.metadata;
+    for (auto& option_schema : schema.options)
+    {
+        auto option = create_option_from_schema(option_schema, file);
+        if (option)
+        {
+            section->register_new_option(option);
+        }
+    }
+
     return section;
 }
 
+std::shared_ptr<wf::config::section_t> wf::config::xml::create_section_from_xml_node(
+    xmlNodePtr node)
+{
+    auto schema = extract_section_schema(node);
+    if (!schema)
+    {
+        return nullptr;
+    }
+
+    return create_section_from_schema(*schema, get_document_url(node));
+}
+
 xmlNodePtr wf::config::xml::get_option_xml_node(
     std::shared_ptr<wf::config::option_base_t> option)
 {
@@ -395,3 +438,27 @@ xmlNodePtr wf::config::xml::get_section_xml_node(
 {
     return section->priv->xml;
 }
+
+std::shared_ptr<const wf::config::xml::metadata_node_t> wf::config::xml::get_option_metadata(
+    std::shared_ptr<wf::config::option_base_t> option)
+{
+    if (!option->priv->metadata && option->priv->xml)
+    {
+        option->priv->metadata =
+            std::make_shared<const metadata_node_t>(extract_metadata(option->priv->xml));
+    }
+
+    return option->priv->metadata;
+}
+
+std::shared_ptr<const wf::config::xml::metadata_node_t> wf::config::xml::get_section_metadata(
+    std::shared_ptr<wf::config::section_t> section)
+{
+    if (!section->priv->metadata && section->priv->xml)
+    {
+        section->priv->metadata =
+            std::make_shared<const metadata_node_t>(extract_metadata(section->priv->xml));
+    }
+
+    return section->priv->metadata;
+}
@@ -0,0 +1,230 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <wayfire/config/config-manager.hpp>
+#include <wayfire/config/file.hpp>
+
+/*
+ * Count the heap allocations, to check that lookups do not allocate, and that
+ * serialization allocates only a bounded number of times.
+ *
+ * All forms of operator new and delete are replaced, so that every allocation
+ * of the program is made with malloc() or aligned_alloc() and released with
+ * free(). This is why the tests live in their own executable.
+ */
+static std::atomic<size_t> allocations{0};
+
+static void *allocate(std::size_t size, std::size_t alignment) noexcept
+{
+    ++allocations;
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t))
+    {
+        return std::malloc(size);
+    }
+
+    /* The size must be a multiple of the alignment */
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+/* Not inlined, otherwise GCC warns about free() on memory from operator new */
+[[gnu::noinline]] static void deallocate(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+static void *allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+    if (void *ptr = allocate(size, alignment))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size)
+{
+    return allocate_or_throw(size, 0);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate_or_throw(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate_or_throw(size, (std::size_t)alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate_or_throw(size, (std::size_t)alignment);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment,
+    const std::nothrow_t&) noexcept
+{
+    return allocate(size, (std::size_t)alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment,
+    const std::nothrow_t&) noexcept
+{
+    return allocate(size, (std::size_t)alignment);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+TEST_CASE("wf::config::config_manager_t - lookups do not allocate")
+{
+    using namespace wf::config;
+
+    config_manager_t config{};
+    auto section = std::make_shared<section_t>("a_section_with_a_long_name");
+    auto option  = std::make_shared<option_t<int>>("an_option_with_a_long_name", 1);
+    section->register_new_option(option);
+    config.merge_section(section);
+
+    const std::string name = "a_section_with_a_long_name/an_option_with_a_long_name";
+    size_t before = allocations;
+    auto found    = config.get_option(name);
+    auto typed    = config.get_option<int>(name);
+    auto missing  = config.get_option("a_section_with_a_long_name/does_not_exist");
+    auto by_view  = config.get_section(std::string_view{name}.substr(0, 26));
+    auto in_section = section->get_option_or("an_option_with_a_long_name");
+    size_t after    = allocations;
+
+    CHECK(after == before);
+    CHECK(found == option);
+    CHECK(typed == option);
+    CHECK(missing == nullptr);
+    CHECK(by_view == section);
+    CHECK(in_section == option);
+}
+
+TEST_CASE("wf::config::config_manager_t - for_each_section does not allocate")
+{
+    using namespace wf::config;
+
+    config_manager_t config{};
+    config.merge_section(std::make_shared<section_t>("b"));
+    config.merge_lazy_section("a", [] { return std::make_shared<section_t>("a"); });
+    CHECK(config.get_all_sections().size() == 2);
+
+    /* Once all sections are materialized, visiting them does not allocate */
+    size_t visited = 0;
+    size_t before  = allocations;
+    config.for_each_section([&] (const std::shared_ptr<section_t>& section)
+    {
+        visited += section.use_count();
+    });
+    CHECK(allocations == before);
+    CHECK(visited == 2);
+}
+
+TEST_CASE("wf::config::save_configuration_options_to_string - allocations")
+{
+    using namespace wf::config;
+
+    config_manager_t config{};
+    for (int i = 0; i < 100; i++)
+    {
+        auto section = std::make_shared<section_t>("a_section_with_a_long_name" +
+            std::to_string(i));
+        for (int j = 0; j < 10; j++)
+        {
+            section->register_new_option(std::make_shared<option_t<std::string>>(
+                "a_string_option_with_a_long_name" + std::to_string(j),
+                "a value which is too long for the small string optimization"));
+            section->register_new_option(std::make_shared<option_t<int>>(
+                "an_int_option_with_a_long_name" + std::to_string(j), j));
+        }
+
+        config.merge_section(section);
+    }
+
+    /* The buffer is sized from an estimate, which may be too small */
+    size_t before = allocations;
+    auto first    = save_configuration_options_to_string(config);
+    CHECK(allocations - before <= 2);
+
+    /* Later saves reuse the size of the previous one */
+    before = allocations;
+    auto second = save_configuration_options_to_string(config);
+    CHECK(allocations - before == 1);
+    CHECK(second == first);
+}
@@ -0,0 +1,110 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <wayfire/config/binding-conflicts.hpp>
+#include <wayfire/config/types.hpp>
+
+template<class Type>
+static std::shared_ptr<wf::config::option_t<Type>> add_option(
+    wf::config::section_t& section, const std::string& name, const std::string& value)
+{
+    auto option = std::make_shared<wf::config::option_t<Type>>(name,
+        wf::option_type::from_string<Type>(value).value());
+    section.register_new_option(option);
+    return option;
+}
+
+TEST_CASE("wf::config::find_binding_conflicts")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    auto core = std::make_shared<section_t>("core");
+    add_option<keybinding_t>(*core, "close", "<super> KEY_Q");
+    add_option<keybinding_t>(*core, "disabled1", "none");
+    add_option<keybinding_t>(*core, "disabled2", "none");
+    add_option<std::string>(*core, "plugins", "expo");
+
+    auto expo = std::make_shared<section_t>("expo");
+    auto toggle = add_option<activatorbinding_t>(*expo, "toggle",
+        "<super> KEY_E | <super> BTN_LEFT | swipe up 4 | hotspot top-left 10x10 500");
+    add_option<buttonbinding_t>(*expo, "button", "<super> BTN_LEFT");
+
+    auto scale = std::make_shared<section_t>("scale");
+    add_option<activatorbinding_t>(*scale, "toggle",
+        "<super> KEY_Q | swipe up 4 | hotspot top-left 20x20 1000");
+    add_option<touchgesture_t>(*scale, "gesture", "swipe down 4");
+    add_option<touchgesture_t>(*scale, "pinch", "pinch in 4");
+
+    /* A gesture without a direction matches all swipes with 3 fingers */
+    auto any_swipe = std::make_shared<option_t<touchgesture_t>>("swipe",
+        touchgesture_t{GESTURE_TYPE_SWIPE, 0, 3});
+    scale->register_new_option(any_swipe);
+    add_option<touchgesture_t>(*scale, "swipe_left", "swipe left 3");
+    add_option<touchgesture_t>(*scale, "swipe_right", "swipe right 3");
+
+    config_manager_t config;
+    config.merge_section(core);
+    config.merge_section(expo);
+    config.merge_section(scale);
+
+    std::vector<binding_conflict_t> expected = {
+        {"<super> BTN_LEFT", {"expo/button", "expo/toggle"}},
+        {"<super> KEY_Q", {"core/close", "scale/toggle"}},
+        {"hotspot left-top 10x10 500", {"expo/toggle", "scale/toggle"}},
+        {"swipe left 3", {"scale/swipe", "scale/swipe_left"}},
+        {"swipe right 3", {"scale/swipe", "scale/swipe_right"}},
+        {"swipe up 4", {"expo/toggle", "scale/toggle"}},
+    };
+
+    auto conflicts = find_binding_conflicts(config);
+    REQUIRE(conflicts.size() == expected.size());
+    for (size_t i = 0; i < conflicts.size(); i++)
+    {
+        CHECK(conflicts[i].binding == expected[i].binding);
+        CHECK(conflicts[i].options == expected[i].options);
+    }
+
+    /* Conflicts of a single option */
+    auto expo_conflicts = find_binding_conflicts(config, "expo/toggle");
+    REQUIRE(expo_conflicts.size() == 3);
+    CHECK(expo_conflicts[0] == expected[0]);
+    CHECK(expo_conflicts[1] == expected[2]);
+    CHECK(expo_conflicts[2] == expected[5]);
+
+    /* The gesture without a direction conflicts with each of the others, but
+     * they do not conflict with each other */
+    auto left_conflicts = find_binding_conflicts(config, "scale/swipe_left");
+    CHECK(left_conflicts == std::vector<binding_conflict_t>{expected[3]});
+    auto any_conflicts = find_binding_conflicts(config, "scale/swipe");
+    CHECK(any_conflicts == std::vector<binding_conflict_t>{expected[3], expected[4]});
+
+    CHECK(find_binding_conflicts(config, "core/plugins").empty());
+    CHECK(find_binding_conflicts(config, "core/missing").empty());
+    CHECK(find_binding_conflicts(config, "scale/pinch").empty());
+
+    /* Re-checking after a change */
+    toggle->set_value(option_type::from_string<activatorbinding_t>(
+        "<super> KEY_E").value());
+    CHECK(find_binding_conflicts(config, "expo/toggle").empty());
+    CHECK(find_binding_conflicts(config, "expo/button").empty());
+    CHECK(find_binding_conflicts(config).size() == 3);
+
+    /* Two gestures without a direction conflict in every direction */
+    auto any_pinch = std::make_shared<option_t<touchgesture_t>>("any_pinch",
+        touchgesture_t{GESTURE_TYPE_PINCH, 0, 4});
+    scale->register_new_option(any_pinch);
+    std::vector<binding_conflict_t> pinch_conflicts = {
+        {"pinch in 4", {"scale/any_pinch", "scale/pinch"}},
+    };
+    CHECK(find_binding_conflicts(config, "scale/pinch") == pinch_conflicts);
+
+    auto other_pinch = std::make_shared<option_t<touchgesture_t>>("other_pinch",
+        touchgesture_t{GESTURE_TYPE_PINCH, 0, 4});
+    scale->register_new_option(other_pinch);
+    pinch_conflicts = {
+        {"pinch in 4", {"scale/any_pinch", "scale/other_pinch", "scale/pinch"}},
+        {"pinch out 4", {"scale/any_pinch", "scale/other_pinch"}},
+    };
+    CHECK(find_binding_conflicts(config, "scale/other_pinch") == pinch_conflicts);
+}
@@ -2,8 +2,11 @@
 #include <doctest/doctest.h>
 
 #include <algorithm>
+#include <stdexcept>
+#include <thread>
 #include <wayfire/config/config-manager.hpp>
 #include <wayfire/config/types.hpp>
+#include <linux/input-event-codes.h>
 
 TEST_CASE("wf::config::config_manager_t")
 {
@@ -88,3 +91,252 @@ TEST_CASE("wf::config::config_manager_t")
     REQUIRE(stored_int_opt);
     CHECK(stored_int_opt->get_value_str() == "6");
 }
+
+TEST_CASE("wf::config::config_manager_t - lazy sections")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    config_manager_t config{};
+    std::vector<std::string> built;
+    auto make_builder = [&] (std::string name, std::string option, int value)
+    {
+        return [&built, name, option, value] ()
+        {
+            built.push_back(name + "/" + option);
+            auto section = std::make_shared<section_t>(name);
+            section->register_new_option(std::make_shared<option_t<int>>(option, value));
+            return section;
+        };
+    };
+
+    config.merge_lazy_section("a", make_builder("a", "x", 1));
+    config.merge_lazy_section("a", make_builder("a", "x", 2));
+    config.merge_lazy_section("a", make_builder("a", "y", 3));
+    config.merge_lazy_section("b", make_builder("b", "z", 4));
+    CHECK(built.empty());
+
+    SUBCASE("get_option builds only the accessed section")
+    {
+        auto x = config.get_option<int>("a/x");
+        REQUIRE(x);
+        CHECK(x->get_value() == 2);
+        CHECK(config.get_option<int>("a/y")->get_value() == 3);
+        CHECK(built == std::vector<std::string>{"a/x", "a/x", "a/y"});
+
+        /* Sections are built only once */
+        CHECK(config.get_section("a")->get_option("x") == x);
+        CHECK(built.size() == 3);
+    }
+
+    SUBCASE("merge_section merges after the lazy sections")
+    {
+        auto section = std::make_shared<section_t>("b");
+        section->register_new_option(std::make_shared<option_t<int>>("z", 5));
+        config.merge_section(section);
+        CHECK(built == std::vector<std::string>{"b/z"});
+        CHECK(config.get_option<int>("b/z")->get_value() == 5);
+    }
+
+    SUBCASE("get_all_sections builds everything")
+    {
+        CHECK(config.get_all_sections().size() == 2);
+        CHECK(built.size() == 4);
+        CHECK(config.get_section("c") == nullptr);
+    }
+
+    SUBCASE("Lookups from several threads build each section once")
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            auto name = "s" + std::to_string(i);
+            config.merge_lazy_section(name, make_builder(name, "o", i));
+        }
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&] ()
+            {
+                for (int i = 99; i >= 0; i--)
+                {
+                    auto option = config.get_option<int>("s" + std::to_string(i) + "/o");
+                    CHECK((option && (option->get_value() == i)));
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        CHECK(built.size() == 100);
+    }
+
+    SUBCASE("Building a section does not race with for_each_section")
+    {
+        std::vector<std::thread> threads;
+        threads.emplace_back([&] ()
+        {
+            CHECK(config.get_section("b") != nullptr);
+        });
+
+        for (int t = 0; t < 3; t++)
+        {
+            threads.emplace_back([&] ()
+            {
+                for (int i = 0; i < 100; i++)
+                {
+                    size_t count = 0;
+                    config.for_each_section([&] (const std::shared_ptr<section_t>&)
+                    {
+                        ++count;
+                    });
+                    CHECK(count == 2);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        CHECK(built.size() == 4);
+    }
+}
+
+TEST_CASE("wf::config::config_manager_t - option handles")
+{
+    using namespace wf::config;
+
+    config_manager_t config{};
+    auto section = std::make_shared<section_t>("section");
+    auto option  = std::make_shared<option_t<int>>("option", 1);
+    section->register_new_option(option);
+    config.merge_section(section);
+
+    CHECK(!config.get_option_handle("section/missing").is_valid());
+    CHECK(!config.get_option_handle("invalid").is_valid());
+    CHECK(config.get_option(option_handle_t{}) == nullptr);
+    CHECK(config.get_option(option_handle_t{42}) == nullptr);
+
+    auto handle = config.get_option_handle("section/option");
+    REQUIRE(handle.is_valid());
+    CHECK(config.get_option_handle("section/option").id == handle.id);
+    CHECK(config.get_option(handle) == option);
+    CHECK(config.get_option<int>(handle) == option);
+    CHECK(config.get_option<double>(handle) == nullptr);
+
+    /* Merging sets the value of the existing option */
+    auto merged = std::make_shared<section_t>("section");
+    merged->register_new_option(std::make_shared<option_t<int>>("option", 5));
+    config.merge_section(merged);
+    CHECK(config.get_option(handle) == option);
+    CHECK(config.get_option<int>(handle)->get_value() == 5);
+
+    /* Replaced and removed options are tracked */
+    auto replacement = std::make_shared<option_t<int>>("option", 2);
+    section->register_new_option(replacement);
+    CHECK(config.get_option(handle) == replacement);
+    section->unregister_option(replacement);
+    CHECK(config.get_option(handle) == nullptr);
+    section->register_new_option(option);
+    CHECK(config.get_option(handle) == option);
+}
+
+TEST_CASE("wf::config::config_manager_t - for_each_section")
+{
+    using namespace wf::config;
+
+    config_manager_t config{};
+    config.merge_section(std::make_shared<section_t>("b"));
+    config.merge_lazy_section("a", [] { return std::make_shared<section_t>("a"); });
+
+    std::vector<std::string> names;
+    config.for_each_section([&] (const std::shared_ptr<section_t>& section)
+    {
+        names.push_back(section->get_name());
+    });
+
+    CHECK(names == std::vector<std::string>{"a", "b"});
+    CHECK(config.get_all_sections().size() == 2);
+}
+
+TEST_CASE("wf::config::config_manager_t - get_options_for_binding")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    auto parse_activator = [] (const std::string& str)
+    {
+        return option_type::from_string<activatorbinding_t>(str).value();
+    };
+
+    const keybinding_t key_e{KEYBOARD_MODIFIER_LOGO, KEY_E};
+    const keybinding_t key_t{KEYBOARD_MODIFIER_LOGO, KEY_T};
+    const buttonbinding_t button{KEYBOARD_MODIFIER_LOGO, BTN_LEFT};
+    const touchgesture_t swipe_up{GESTURE_TYPE_SWIPE, GESTURE_DIRECTION_UP, 3};
+    const touchgesture_t swipe_any{GESTURE_TYPE_SWIPE, 0, 3};
+
+    auto key = std::make_shared<option_t<keybinding_t>>("key", key_e);
+    auto activator = std::make_shared<option_t<activatorbinding_t>>("activator",
+        parse_activator("<super> KEY_E | <super> BTN_LEFT | swipe up 3"));
+    auto other = std::make_shared<option_t<int>>("other", 0);
+
+    auto section = std::make_shared<section_t>("bindings");
+    section->register_new_option(key);
+    section->register_new_option(activator);
+    section->register_new_option(other);
+
+    config_manager_t config;
+    config.merge_section(section);
+
+    using option_list_t = std::vector<std::shared_ptr<option_base_t>>;
+    auto sorted = [] (option_list_t list)
+    {
+        std::sort(list.begin(), list.end());
+        return list;
+    };
+
+    CHECK(sorted(config.get_options_for_binding(key_e)) ==
+        sorted({key, activator}));
+    CHECK(config.get_options_for_binding(key_t).empty());
+    CHECK(config.get_options_for_binding(button) == option_list_t{activator});
+    CHECK(config.get_options_for_binding(swipe_up) == option_list_t{activator});
+    CHECK(config.get_options_for_binding(swipe_any) == option_list_t{activator});
+
+    /* Value changes are picked up */
+    key->set_value(key_t);
+    CHECK(config.get_options_for_binding(key_e) == option_list_t{activator});
+    CHECK(config.get_options_for_binding(key_t) == option_list_t{key});
+
+    /* Changes in a notification batch are picked up when it ends */
+    begin_notification_batch();
+    activator->set_value(parse_activator("<super> KEY_T"));
+    CHECK(config.get_options_for_binding(button) == option_list_t{activator});
+    end_notification_batch();
+    CHECK(config.get_options_for_binding(button).empty());
+    CHECK(config.get_options_for_binding(swipe_up).empty());
+    CHECK(sorted(config.get_options_for_binding(key_t)) ==
+        sorted({key, activator}));
+
+    /* Registered and unregistered options are picked up */
+    auto button_opt = std::make_shared<option_t<buttonbinding_t>>("button", button);
+    section->register_new_option(button_opt);
+    CHECK(config.get_options_for_binding(button) == option_list_t{button_opt});
+    section->unregister_option(key);
+    CHECK(config.get_options_for_binding(key_t) == option_list_t{activator});
+
+    /* Unregistered options are no longer tracked */
+    key->set_value(key_e);
+    CHECK(config.get_options_for_binding(key_e).empty());
+
+    /* New and lazy sections are picked up */
+    auto gesture_section = std::make_shared<section_t>("gestures");
+    auto gesture = std::make_shared<option_t<touchgesture_t>>("gesture", swipe_up);
+    gesture_section->register_new_option(gesture);
+    config.merge_lazy_section("gestures", [=] { return gesture_section; });
+    CHECK(config.get_options_for_binding(swipe_any) == option_list_t{gesture});
+}
@@ -4,13 +4,22 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <set>
+#include <thread>
 
 #include <wayfire/config/file.hpp>
 #include <wayfire/util/log.hpp>
 #include <wayfire/config/types.hpp>
 #include "wayfire/config/compound-option.hpp"
+#include <wayfire/config/xml.hpp>
+#include <linux/input-event-codes.h>
+#include "../src/config-manager-impl.hpp"
 #include "../src/option-impl.hpp"
 
 const std::string contents =
@@ -128,6 +137,43 @@ TEST_CASE("wf::config::load_configuration_options_from_string - "
     CHECK(opt->get_value_untyped().empty());
 }
 
+const std::string continuation_contents =
+    "[section]\r\n"
+    "option1 = a \\\n"
+    "\\\n"
+    "b\\#c \\\\\n"
+    "option2 = \\\\\\\\\\\n"
+    "\n"
+    "option3 = d\\\n"
+    "  e # f \\\n"
+    "wrong \\\n"
+    "still wrong\n"
+    "option4 = last\\";
+
+TEST_CASE("wf::config::load_configuration_options_from_string - continuation lines")
+{
+    std::stringstream log;
+    wf::log::initialize_logging(log, wf::log::LOG_LEVEL_DEBUG,
+        wf::log::LOG_COLOR_MODE_OFF);
+
+    wf::config::config_manager_t config;
+    load_configuration_options_from_string(config, continuation_contents, "test");
+
+    auto section = config.get_section("section");
+    REQUIRE(section);
+    CHECK(section->get_option("option1")->get_value_str() == "a b#c \\");
+    CHECK(section->get_option("option2")->get_value_str() == "\\\\\\\\");
+    CHECK(section->get_option("option3")->get_value_str() == "d  e");
+    CHECK(section->get_option("option4")->get_value_str() == "last");
+    CHECK(section->get_registered_options().size() == 4);
+
+    /* Errors are reported at the first line of a joined line */
+    EXPECT_LINE(log, "Error in file test:9");
+
+    wf::log::initialize_logging(std::cout, wf::log::LOG_LEVEL_DEBUG,
+        wf::log::LOG_COLOR_MODE_OFF);
+}
+
 const std::string minimal_config_with_opt = R"(
 [section]
 option = value
@@ -155,6 +201,116 @@ TEST_CASE("wf::config::load_configuration_options_from_string - lock & reload")
     }
 }
 
+TEST_CASE("wf::config::load_configuration_options_from_string - incremental reload")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    const std::string initial = "[a]\nx = 1\ny = invalid\n[b]\nz = 2\n";
+    const std::string b_changed = "[a]\nx = 1\ny = invalid\n[b]\nz = 3\n";
+
+    config_manager_t cfg;
+    auto a = std::make_shared<section_t>("a");
+    a->register_new_option(std::make_shared<option_t<int>>("x", 0));
+    a->register_new_option(std::make_shared<option_t<int>>("y", 0));
+    a->register_new_option(std::make_shared<option_t<int>>("w", 0));
+    cfg.merge_section(a);
+
+    std::stringstream log;
+    wf::log::initialize_logging(log, wf::log::LOG_LEVEL_DEBUG,
+        wf::log::LOG_COLOR_MODE_OFF);
+
+    load_configuration_options_from_string(cfg, initial, "test");
+    CHECK(cfg.get_option("a/x")->get_value_str() == "1");
+    CHECK(cfg.get_option("b/z")->get_value_str() == "2");
+    EXPECT_LINE(log, "Error in file test:3");
+
+    SUBCASE("Unchanged sections are skipped")
+    {
+        log.str("");
+        log.clear();
+        load_configuration_options_from_string(cfg, b_changed, "test");
+        CHECK(cfg.get_option("b/z")->get_value_str() == "3");
+        CHECK(log.str().find("test:3") == std::string::npos);
+    }
+
+    SUBCASE("Sections are reloaded if options were changed")
+    {
+        cfg.get_option<int>("a/x")->set_value(5);
+        load_configuration_options_from_string(cfg, b_changed, "test");
+        CHECK(cfg.get_option("a/x")->get_value_str() == "1");
+    }
+
+    SUBCASE("Sections are reloaded if options were replaced")
+    {
+        a->register_new_option(std::make_shared<option_t<int>>("x", 0));
+        load_configuration_options_from_string(cfg, initial, "test");
+        CHECK(cfg.get_option("a/x")->get_value_str() == "1");
+    }
+
+    SUBCASE("Sections are reloaded if default values were changed")
+    {
+        /* For ex. by override_defaults(), w is not in the file */
+        CHECK(cfg.get_option("a/w")->set_default_value_str("7"));
+        load_configuration_options_from_string(cfg, initial, "test");
+        CHECK(cfg.get_option("a/w")->get_value_str() == "7");
+    }
+
+    SUBCASE("Removed sections are reset")
+    {
+        load_configuration_options_from_string(cfg, "[b]\nz = 2\n", "test");
+        CHECK(cfg.get_option("a/x")->get_value_str() == "0");
+        CHECK(cfg.get_option("b/z")->get_value_str() == "2");
+    }
+
+    wf::log::initialize_logging(std::cout, wf::log::LOG_LEVEL_DEBUG,
+        wf::log::LOG_COLOR_MODE_OFF);
+}
+
+TEST_CASE("wf::config::load_configuration_options_from_string - change set")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    config_manager_t cfg;
+    auto a = std::make_shared<section_t>("a");
+    a->register_new_option(std::make_shared<option_t<int>>("x", 0));
+    a->register_new_option(std::make_shared<option_t<int>>("y", 0));
+    a->register_new_option(std::make_shared<option_t<int>>("w", 0));
+    cfg.merge_section(a);
+
+    load_configuration_options_from_string(cfg, "[a]\nx = 1\ny = 2\n[b]\nz = 2\n");
+
+    auto names = [] (const std::vector<config_change_set_t::entry_t>& entries)
+    {
+        std::set<std::string> result;
+        for (auto& e : entries)
+        {
+            result.insert(e.section->get_name() + "/" + e.option->get_name());
+        }
+
+        return result;
+    };
+
+    config_change_set_t changes;
+    load_configuration_options_from_string(cfg,
+        "[a]\nx = 1\nw = 0\n[b]\nz = 3\nv = 4\n", "test", changes);
+
+    CHECK(names(changes.changed) == std::set<std::string>{"a/y", "b/z", "b/v"});
+    CHECK(names(changes.added) == std::set<std::string>{"a/w", "b/v"});
+    CHECK(names(changes.removed) == std::set<std::string>{"a/y"});
+    REQUIRE(changes.sections.size() == 2);
+
+    changes = {};
+    load_configuration_options_from_string(cfg,
+        "[a]\nx = 1\nw = 0\n[b]\nz = 4\nv = 4\n", "test", changes);
+    CHECK(names(changes.changed) == std::set<std::string>{"b/z"});
+    CHECK(changes.added.empty());
+    CHECK(changes.removed.empty());
+    REQUIRE(changes.sections.size() == 1);
+    CHECK(changes.sections[0]->get_name() == "b");
+}
+
 wf::config::config_manager_t build_simple_config()
 {
     using namespace wf;
@@ -202,6 +358,13 @@ TEST_CASE("wf::config::save_configuration_options_to_string")
     CHECK(stringified == simple_config_source);
 }
 
+TEST_CASE("wf::config::save_configuration_options_to_stream")
+{
+    std::ostringstream out;
+    wf::config::save_configuration_options_to_stream(build_simple_config(), out);
+    CHECK(out.str() == simple_config_source);
+}
+
 TEST_CASE("wf::config::save_configuration_options_to_string - compound options erase")
 {
     using namespace wf;
@@ -317,6 +480,46 @@ TEST_CASE("wf::config::load_configuration_options_from_file - success")
     check_int_test_config(manager);
 }
 
+TEST_CASE("wf::config::load_configuration_options_from_file - empty files and pipes")
+{
+    wf::config::config_manager_t manager;
+    load_configuration_options_from_string(manager, minimal_config_with_opt);
+
+    char dir_template[] = "/tmp/wf-config-test-XXXXXX";
+    REQUIRE(mkdtemp(dir_template));
+    std::string dir = dir_template;
+
+    SUBCASE("empty file")
+    {
+        std::ofstream{dir + "/empty.ini"};
+        CHECK(load_configuration_options_from_file(manager, dir + "/empty.ini"));
+        CHECK(manager.get_option("section/option")->get_value_str() == "");
+        unlink((dir + "/empty.ini").c_str());
+    }
+
+    SUBCASE("pipe")
+    {
+        std::string fifo = dir + "/fifo.ini";
+        REQUIRE(mkfifo(fifo.c_str(), 0600) == 0);
+
+        int pid = fork();
+        if (pid == 0)
+        {
+            std::ofstream out{fifo};
+            out << "[section]\noption = from_pipe\n";
+            out.close();
+            _exit(0);
+        }
+
+        CHECK(load_configuration_options_from_file(manager, fifo));
+        CHECK(manager.get_option("section/option")->get_value_str() == "from_pipe");
+        waitpid(pid, NULL, 0);
+        unlink(fifo.c_str());
+    }
+
+    rmdir(dir.c_str());
+}
+
 TEST_CASE("wf::config::save_configuration_to_file - success")
 {
     std::string test_config = std::string(TEST_SOURCE "/dummy.ini");
@@ -342,6 +545,235 @@ TEST_CASE("wf::config::save_configuration_to_file - success")
     close(fd);
 }
 
+TEST_CASE("wf::config::save_configuration_to_file - atomic")
+{
+    char dir_template[] = "/tmp/wf-config-save-XXXXXX";
+    std::string dir    = mkdtemp(dir_template);
+    std::string target = dir + "/real.ini";
+    std::string link   = dir + "/link.ini";
+
+    {
+        std::ofstream clr(target, std::ios::trunc);
+        clr << "Dummy";
+    }
+
+    chmod(target.c_str(), 0640);
+    REQUIRE(symlink(target.c_str(), link.c_str()) == 0);
+
+    wf::config::save_configuration_to_file(build_simple_config(), link,
+        wf::config::SAVE_ATOMIC);
+
+    std::ifstream infile(target);
+    std::string file_contents((std::istreambuf_iterator<char>(infile)),
+        std::istreambuf_iterator<char>());
+    CHECK(file_contents == simple_config_source);
+
+    struct stat st;
+    REQUIRE(lstat(link.c_str(), &st) == 0);
+    CHECK(S_ISLNK(st.st_mode));
+    REQUIRE(stat(target.c_str(), &st) == 0);
+    CHECK((st.st_mode & 0777) == 0640);
+
+    /* No temporary files are left behind */
+    int entries = 0;
+    auto d = opendir(dir.c_str());
+    while (auto entry = readdir(d))
+    {
+        std::string name = entry->d_name;
+        entries += (name != ".") && (name != "..");
+    }
+
+    closedir(d);
+    CHECK(entries == 2);
+
+    unlink(link.c_str());
+    unlink(target.c_str());
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("wf::config::save_configuration_to_file - atomic, owner and dangling symlinks")
+{
+    char dir_template[] = "/tmp/wf-config-save-XXXXXX";
+    std::string dir    = mkdtemp(dir_template);
+    std::string target = dir + "/real.ini";
+    std::string link   = dir + "/link.ini";
+
+    SUBCASE("The target of a dangling symlink is created")
+    {
+        REQUIRE(symlink("real.ini", link.c_str()) == 0);
+        wf::config::save_configuration_to_file(build_simple_config(), link,
+            wf::config::SAVE_ATOMIC);
+
+        struct stat st;
+        REQUIRE(lstat(link.c_str(), &st) == 0);
+        CHECK(S_ISLNK(st.st_mode));
+        std::ifstream infile(target);
+        std::string file_contents((std::istreambuf_iterator<char>(infile)),
+            std::istreambuf_iterator<char>());
+        CHECK(file_contents == simple_config_source);
+        unlink(link.c_str());
+    }
+
+    SUBCASE("The owner is kept if possible")
+    {
+        std::ofstream{target} << "Dummy";
+        bool can_chown = (chown(target.c_str(), 1234, 1234) == 0);
+        wf::config::save_configuration_to_file(build_simple_config(), target,
+            wf::config::SAVE_ATOMIC);
+
+        struct stat st;
+        REQUIRE(stat(target.c_str(), &st) == 0);
+        if (can_chown)
+        {
+            CHECK(st.st_uid == 1234);
+            CHECK(st.st_gid == 1234);
+        }
+    }
+
+    unlink(target.c_str());
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("wf::config::save_configuration_to_file - preserve format")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    char dir_template[] = "/tmp/wf-config-save-XXXXXX";
+    std::string dir  = mkdtemp(dir_template);
+    std::string file = dir + "/wayfire.ini";
+
+    const std::string source =
+        R"(# My config
+[core]
+  plugins = a b   # the plugins
+vwidth=3
+title =
+name=
+
+[section2]
+opt = 1.2
+hey_k1 = 1
+bey_k1 = 1.2
+hey_k2 = 2
+bey_k2 = 2.5
+)";
+
+    {
+        std::ofstream out(file);
+        out << source;
+    }
+
+    auto core = std::make_shared<section_t>("core");
+    core->register_new_option(std::make_shared<option_t<std::string>>("plugins", ""));
+    core->register_new_option(std::make_shared<option_t<int>>("vwidth", 3));
+    core->register_new_option(std::make_shared<option_t<int>>("xwidth", 1));
+    core->register_new_option(std::make_shared<option_t<int>>("yheight", 1));
+    core->register_new_option(std::make_shared<option_t<std::string>>("title", ""));
+    core->register_new_option(std::make_shared<option_t<std::string>>("name", ""));
+
+    compound_option_t::entries_t entries;
+    entries.push_back(std::make_unique<compound_option_entry_t<int>>("hey_"));
+    entries.push_back(std::make_unique<compound_option_entry_t<double>>("bey_"));
+    auto list = std::make_shared<compound_option_t>("list", std::move(entries));
+    auto section2 = std::make_shared<section_t>("section2");
+    section2->register_new_option(std::make_shared<option_t<double>>("opt", 0.0));
+    section2->register_new_option(list);
+
+    config_manager_t config;
+    config.merge_section(core);
+    config.merge_section(section2);
+    REQUIRE(load_configuration_options_from_file(config, file));
+
+    auto read_file = [&] ()
+    {
+        std::ifstream in(file);
+        return std::string((std::istreambuf_iterator<char>(in)),
+            std::istreambuf_iterator<char>());
+    };
+
+    SUBCASE("Only changed lines are modified")
+    {
+        config.get_option<std::string>("core/plugins")->set_value("a b c");
+        config.get_option<int>("core/xwidth")->set_value(5);
+        config.get_option<std::string>("core/title")->set_value("My desktop");
+        config.get_option<std::string>("core/name")->set_value("n");
+        auto value = list->get_value_untyped();
+        value.pop_back();
+        value.push_back({"k3", "3", "3.5"});
+        list->set_value_untyped(value);
+
+        save_configuration_to_file(config, file, SAVE_PRESERVE_FORMAT);
+        CHECK(read_file() ==
+            R"(# My config
+[core]
+  plugins = a b c   # the plugins
+vwidth=3
+title = My desktop
+name=n
+xwidth = 5
+
+[section2]
+opt = 1.2
+hey_k1 = 1
+bey_k1 = 1.2
+bey_k3 = 3.5
+hey_k3 = 3
+)");
+    }
+
+    SUBCASE("New sections are appended")
+    {
+        auto section3 = std::make_shared<section_t>("section3");
+        section3->register_new_option(std::make_shared<option_t<std::string>>(
+            "text", "a#b"));
+        config.merge_section(section3);
+        config.get_option<std::string>("section3/text")->set_value("c#d");
+
+        save_configuration_to_file(config, file, SAVE_PRESERVE_FORMAT);
+        CHECK(read_file() == source + "\n[section3]\ntext = c\\#d\n");
+    }
+
+    SUBCASE("Edits by other writers are not lost")
+    {
+        int fd = open(file.c_str(), O_RDWR | O_APPEND);
+        flock(fd, LOCK_EX);
+
+        config.get_option<int>("core/xwidth")->set_value(5);
+        std::thread saver([&] ()
+        {
+            save_configuration_to_file(config, file, SAVE_PRESERVE_FORMAT);
+        });
+
+        /* The file is read only after we have written to it */
+        usleep(100e3);
+        std::string extra = "\n[section4]\nnew = 1\n";
+        REQUIRE(write(fd, extra.data(), extra.size()) == (ssize_t)extra.size());
+        flock(fd, LOCK_UN);
+        close(fd);
+        saver.join();
+
+        auto contents = read_file();
+        CHECK(contents.find("xwidth = 5\n") != std::string::npos);
+        CHECK(contents.find(extra) != std::string::npos);
+    }
+
+    SUBCASE("File is not written without changes")
+    {
+        timespec times[2] = {{0, 0}, {0, 0}};
+        utimensat(AT_FDCWD, file.c_str(), times, 0);
+        save_configuration_to_file(config, file, SAVE_PRESERVE_FORMAT | SAVE_ATOMIC);
+
+        struct stat st;
+        REQUIRE(stat(file.c_str(), &st) == 0);
+        CHECK(st.st_mtime == 0);
+        CHECK(read_file() == source);
+    }
+
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+}
+
 TEST_CASE("wf::config::build_configuration")
 {
     wf::log::initialize_logging(std::cout, wf::log::LOG_LEVEL_DEBUG,
@@ -377,6 +809,13 @@ TEST_CASE("wf::config::build_configuration")
     CHECK(o5->get_value_str() == "Option5Sys");
     CHECK(o6->get_value_str() == "10"); // bounds from xml applied
 
+    /* Only the owned metadata is kept by default */
+    CHECK(xml::get_option_xml_node(o1) == nullptr);
+    auto metadata = xml::get_option_metadata(o1);
+    REQUIRE(metadata != nullptr);
+    CHECK(metadata->get_attribute("name") == "option1");
+    CHECK(xml::get_option_metadata(o1) == metadata);
+
     o1->reset_to_default();
     o2->reset_to_default();
     o3->reset_to_default();
@@ -391,3 +830,307 @@ TEST_CASE("wf::config::build_configuration")
     CHECK(o5->get_value_str() == "Option5Sys");
     CHECK(o6->get_value_str() == "1");
 }
+
+TEST_CASE("wf::config::build_configuration - schema cache")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    std::string xmldir   = std::string(TEST_SOURCE "/int_test/xml");
+    std::string sysconf  = std::string(TEST_SOURCE "/int_test/sys.ini");
+    std::string userconf = std::string(TEST_SOURCE "/int_test/config.ini");
+
+    char dir_template[] = "/tmp/wf-config-cache-XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+
+    build_options_t options;
+    options.schema_cache     = dir + "/schema.cache";
+    options.retain_xml_nodes = true;
+
+    auto check_config = [&] (bool expect_xml_nodes)
+    {
+        auto config = build_configuration({xmldir}, sysconf, userconf, options);
+        check_int_test_config(config, "10");
+
+        auto o1 = config.get_option("section1/option1");
+        auto o5 = config.get_option("section2/option5");
+        auto o6 = config.get_option("sectionobj:objtest/option6");
+        REQUIRE(o5);
+        REQUIRE(o6);
+        CHECK(std::dynamic_pointer_cast<option_t<int>>(o1) != nullptr);
+        CHECK(o5->get_value_str() == "Option5Sys");
+        CHECK(o6->get_value_str() == "10"); // bounds applied
+
+        CHECK((xml::get_option_xml_node(o1) != nullptr) == expect_xml_nodes);
+        CHECK((xml::get_section_xml_node(config.get_section("section1")) != nullptr) ==
+            expect_xml_nodes);
+
+        auto metadata = xml::get_option_metadata(o1);
+        REQUIRE(metadata != nullptr);
+        CHECK(metadata->get_attribute("name") == "option1");
+        CHECK(metadata->get_child("max")->text == "10");
+        CHECK(xml::get_section_metadata(config.get_section("section1"))->
+            get_child("category")->text == "General");
+
+        /* Options declared in XML are still saved */
+        auto saved = save_configuration_options_to_string(config);
+        CHECK(saved.find("option4 = DoesNotExistInConfig") != std::string::npos);
+    };
+
+    check_config(true);
+    struct stat st;
+    REQUIRE(stat(options.schema_cache.c_str(), &st) == 0);
+    auto cache_mtime = st.st_mtim;
+
+    // Second run is served from the cache, which is not rewritten
+    check_config(false);
+    REQUIRE(stat(options.schema_cache.c_str(), &st) == 0);
+    CHECK(st.st_mtim.tv_sec == cache_mtime.tv_sec);
+    CHECK(st.st_mtim.tv_nsec == cache_mtime.tv_nsec);
+
+    SUBCASE("Corrupted cache is ignored")
+    {
+        {
+            std::ofstream out(options.schema_cache, std::ios::trunc);
+            out << "WFSCHEMA garbage";
+        }
+
+        check_config(true);
+        check_config(false);
+    }
+
+    SUBCASE("Deeply nested metadata is rejected")
+    {
+        {
+            std::ofstream out(options.schema_cache, std::ios::trunc | std::ios::binary);
+            auto write_u32 = [&] (uint32_t value) { out.write((char*)&value, 4); };
+            auto write_u64 = [&] (uint64_t value) { out.write((char*)&value, 8); };
+            out << "WFSCHEMA";
+            write_u32(2); // version
+            write_u32(1); // files
+            write_u32(1);
+            out << "f";
+            write_u64(0);
+            write_u64(0);
+            write_u64(0);
+            write_u32(1); // sections
+            write_u32(1);
+            out << "s";
+            out.put(1); // has metadata
+            for (int i = 0; i < 1000000; i++)
+            {
+                write_u32(0); // name
+                write_u32(0); // attributes
+                write_u32(0); // text
+                write_u32(1); // children
+            }
+        }
+
+        check_config(true);
+        check_config(false);
+    }
+
+    SUBCASE("Entries of other XML directories are kept")
+    {
+        char other_template[] = "/tmp/wf-config-xml-XXXXXX";
+        std::string other = mkdtemp(other_template);
+        {
+            std::ofstream out(other + "/other.xml");
+            out << "<wayfire><plugin name=\"other\"></plugin></wayfire>";
+        }
+
+        build_configuration({other}, "", "", options);
+        check_config(false);
+
+        /* Entries of files which no longer exist are dropped */
+        unlink((other + "/other.xml").c_str());
+        rmdir(other.c_str());
+        check_config(false);
+        std::ifstream in(options.schema_cache, std::ios::binary);
+        std::string contents{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        CHECK(contents.find(other) == std::string::npos);
+    }
+
+    unlink(options.schema_cache.c_str());
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("wf::config::build_configuration - without XML nodes")
+{
+    using namespace wf::config;
+
+    std::string xmldir   = std::string(TEST_SOURCE "/int_test/xml");
+    std::string sysconf  = std::string(TEST_SOURCE "/int_test/sys.ini");
+    std::string userconf = std::string(TEST_SOURCE "/int_test/config.ini");
+
+    /* This is the default */
+    auto config = build_configuration({xmldir}, sysconf, userconf);
+    check_int_test_config(config, "10");
+
+    auto o6 = config.get_option("sectionobj:objtest/option6");
+    REQUIRE(o6);
+    CHECK(xml::get_option_xml_node(o6) == nullptr);
+    CHECK(xml::get_section_xml_node(config.get_section("section1")) == nullptr);
+
+    auto metadata = xml::get_option_metadata(o6);
+    REQUIRE(metadata != nullptr);
+    CHECK(metadata->get_child("default")->text == "1");
+    CHECK(xml::get_section_metadata(config.get_section("sectionobj:objtest")) ==
+        xml::get_section_metadata(config.get_section("sectionobj")));
+
+    /* The XML files are read with the streaming parser, with the same result
+     * as with the document tree */
+    build_options_t options;
+    options.retain_xml_nodes = true;
+    auto dom_config = build_configuration({xmldir}, sysconf, userconf, options);
+    auto dom_o6 = dom_config.get_option("sectionobj:objtest/option6");
+    CHECK(xml::get_option_xml_node(dom_o6) != nullptr);
+
+    /* The XML nodes are kept, so the metadata is extracted only on demand */
+    CHECK(dom_o6->priv->metadata == nullptr);
+    CHECK(xml::get_option_metadata(dom_o6)->get_child("default")->text == "1");
+    CHECK(save_configuration_options_to_string(config) ==
+        save_configuration_options_to_string(dom_config));
+}
+
+TEST_CASE("wf::config::build_configuration - lazy sections")
+{
+    using namespace wf::config;
+
+    std::string xmldir   = std::string(TEST_SOURCE "/int_test/xml");
+    std::string sysconf  = std::string(TEST_SOURCE "/int_test/sys.ini");
+    std::string userconf = std::string(TEST_SOURCE "/int_test/config.ini");
+
+    build_options_t options;
+    options.lazy_sections = true;
+
+    SUBCASE("Sections in the config files are built")
+    {
+        auto config = build_configuration({xmldir}, sysconf, userconf, options);
+        CHECK(config.priv->sections.count("section1") == 1);
+        CHECK(config.priv->sections.count("sectionobj") == 1);
+        check_int_test_config(config, "10");
+        CHECK(config.get_option("sectionobj:objtest/option6")->get_value_str() == "10");
+        CHECK(config.get_option("section2/option5")->get_value_str() == "Option5Sys");
+
+        auto eager = build_configuration({xmldir}, sysconf, userconf);
+        CHECK(save_configuration_options_to_string(config) ==
+            save_configuration_options_to_string(eager));
+    }
+
+    SUBCASE("Other sections are built on access")
+    {
+        auto config = build_configuration({xmldir}, "/does/not/exist",
+            "/does/not/exist", options);
+        CHECK(config.priv->sections.empty());
+
+        auto option = config.get_option("section1/option1");
+        REQUIRE(option);
+        CHECK(option->get_value_str() == "4");
+        CHECK(config.priv->sections.size() == 1);
+        CHECK(config.get_all_sections().size() == 3);
+    }
+}
+
+TEST_CASE("wf::config::build_configuration - binding lookups in lazy sections")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    char dir_template[] = "/tmp/wf-config-xml-XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    {
+        std::ofstream out(dir + "/plain.xml");
+        out << "<wayfire><plugin name=\"plain\"><option name=\"value\" type=\"int\">" <<
+            "<default>1</default></option></plugin></wayfire>";
+    }
+
+    {
+        std::ofstream out(dir + "/bound.xml");
+        out << "<wayfire><plugin name=\"bound\"><option name=\"toggle\" type=\"key\">" <<
+            "<default>&lt;super&gt; KEY_T</default></option></plugin></wayfire>";
+    }
+
+    build_options_t options;
+    options.lazy_sections = true;
+    auto config = build_configuration({dir}, "", "", options);
+    CHECK(config.priv->sections.empty());
+
+    /* Only the sections which declare bindings are built */
+    CHECK(config.get_options_for_binding(
+        keybinding_t{KEYBOARD_MODIFIER_LOGO, KEY_T}) ==
+        std::vector<std::shared_ptr<option_base_t>>{config.get_option("bound/toggle")});
+    CHECK(config.priv->sections.size() == 1);
+
+    /* Sections built later are picked up */
+    CHECK(config.get_option("plain/value") != nullptr);
+    CHECK(config.get_options_for_binding(
+        keybinding_t{KEYBOARD_MODIFIER_LOGO, KEY_T}).size() == 1);
+    CHECK(config.priv->sections.size() == 2);
+
+    unlink((dir + "/plain.xml").c_str());
+    unlink((dir + "/bound.xml").c_str());
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("wf::config::build_configuration - parallel XML loading")
+{
+    using namespace wf::config;
+
+    std::string xmldir   = std::string(TEST_SOURCE "/int_test/xml");
+    std::string sysconf  = std::string(TEST_SOURCE "/int_test/sys.ini");
+    std::string userconf = std::string(TEST_SOURCE "/int_test/config.ini");
+
+    auto sequential = build_configuration({xmldir}, sysconf, userconf);
+    for (unsigned int threads : {0u, 2u, 8u})
+    {
+        build_options_t options;
+        options.xml_threads = threads;
+        auto parallel = build_configuration({xmldir, xmldir}, sysconf, userconf, options);
+        check_int_test_config(parallel, "10");
+        CHECK(save_configuration_options_to_string(parallel) ==
+            save_configuration_options_to_string(sequential));
+        CHECK(parallel.get_all_sections().size() == sequential.get_all_sections().size());
+    }
+}
+
+TEST_CASE("wf::config::build_configuration - parallel loading of many sections")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    /* Each file is loaded on its own thread, and its options are registered
+     * there. Build the tests with -Db_sanitize=thread to check for races. */
+    char dir_template[] = "/tmp/wf-config-xml-XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    const size_t nr_files = 16;
+    for (size_t i = 0; i < nr_files; i++)
+    {
+        std::ofstream out(dir + "/plugin" + std::to_string(i) + ".xml");
+        out << "<wayfire><plugin name=\"plugin" << i << "\">";
+        for (int j = 0; j < 20; j++)
+        {
+            out << "<option name=\"option" << j << "\" type=\"int\">" <<
+                "<default>" << j << "</default></option>";
+        }
+
+        out << "<option name=\"toggle\" type=\"activator\">" <<
+            "<default>&lt;super&gt; KEY_T</default></option>";
+        out << "</plugin></wayfire>";
+    }
+
+    build_options_t options;
+    options.xml_threads = 8;
+    auto config = build_configuration({dir}, "", "", options);
+    CHECK(config.get_all_sections().size() == nr_files);
+    CHECK(config.get_options_for_binding(
+        keybinding_t{KEYBOARD_MODIFIER_LOGO, KEY_T}).size() == nr_files);
+    CHECK(config.get_option<int>("plugin7/option19")->get_value() == 19);
+
+    for (size_t i = 0; i < nr_files; i++)
+    {
+        unlink((dir + "/plugin" + std::to_string(i) + ".xml").c_str());
+    }
+
+    rmdir(dir.c_str());
+}
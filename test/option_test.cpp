@@ -6,6 +6,8 @@
 #include <wayfire/config/types.hpp>
 #include <linux/input-event-codes.h>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include "../src/option-impl.hpp"
 
 /**
@@ -168,6 +170,258 @@ TEST_CASE("wf::config::option_t<boundable>")
     CHECK(are_bounds_enabled<option_t<double>>::value);
 }
 
+TEST_CASE("wf::config::option_t concurrent reads")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    option_t<std::string> opt("string123", std::string(64, 'a'));
+
+    int callback_called = 0;
+    option_base_t::updated_callback_t callback = [&] ()
+    {
+        ++callback_called;
+    };
+    opt.add_updated_handler(&callback);
+
+    opt.enable_concurrent_reads();
+    CHECK(opt.get_value_concurrent() == std::string(64, 'a'));
+
+    std::atomic<bool> done{false};
+    std::atomic<int> torn_reads{0};
+    std::thread reader([&] ()
+    {
+        while (!done)
+        {
+            auto value = opt.get_value_concurrent();
+            bool uniform = (value.size() == 64) &&
+                std::all_of(value.begin(), value.end(),
+                    [&] (char c) { return c == value[0]; });
+            if (!uniform)
+            {
+                ++torn_reads;
+            }
+        }
+    });
+
+    for (int i = 1; i <= 10000; i++)
+    {
+        opt.set_value(std::string(64, 'a' + i % 26));
+    }
+
+    done = true;
+    reader.join();
+
+    CHECK(torn_reads == 0);
+    CHECK(callback_called == 10000);
+    CHECK(opt.get_value_concurrent() == opt.get_value());
+
+    option_t<int> iopt("int123", 5);
+    iopt.enable_concurrent_reads();
+    iopt.set_maximum(3);
+    CHECK(iopt.get_value_concurrent() == 3);
+
+    auto clone = std::static_pointer_cast<option_t<int>>(iopt.clone_option());
+    clone->set_value(1);
+    CHECK(clone->get_value_concurrent() == 1);
+    CHECK(iopt.get_value_concurrent() == 3);
+}
+
+namespace
+{
+/** Counts its live instances. */
+struct counted_t
+{
+    static std::atomic<int> live;
+    int value;
+
+    counted_t(int value) : value(value)
+    {
+        ++live;
+    }
+
+    counted_t(const counted_t& other) : value(other.value)
+    {
+        ++live;
+    }
+
+    ~counted_t()
+    {
+        --live;
+    }
+};
+
+std::atomic<int> counted_t::live{0};
+}
+
+TEST_CASE("wf::config::concurrent_value_t frees replaced snapshots")
+{
+    using namespace wf::config;
+
+    {
+        concurrent_value_t<counted_t> value{counted_t{0}};
+        std::atomic<bool> done{false};
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 2; i++)
+        {
+            readers.emplace_back([&] ()
+            {
+                while (!done)
+                {
+                    value.load();
+                }
+            });
+        }
+
+        // Readers are always active, but at most two snapshots exist, plus the
+        // copies made by the readers.
+        int max_live = 0;
+        for (int i = 1; i <= 10000; i++)
+        {
+            value.store(counted_t{i});
+            max_live = std::max(max_live, counted_t::live.load());
+        }
+
+        done = true;
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+
+        CHECK(max_live <= 6);
+        CHECK(value.load().value == 10000);
+    }
+
+    CHECK(counted_t::live == 0);
+}
+
+TEST_CASE("wf::config notification batches")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    auto opt1 = std::make_shared<option_t<int>>("opt1", 1);
+    auto opt2 = std::make_shared<option_t<int>>("opt2", 2);
+
+    using updated_callback_t = option_base_t::updated_callback_t;
+    int calls1 = 0, calls2 = 0;
+    int seen_opt2 = 0;
+    updated_callback_t callback1 = [&] ()
+    {
+        ++calls1;
+        seen_opt2 = opt2->get_value();
+    };
+    updated_callback_t callback2 = [&] () { ++calls2; };
+    opt1->add_updated_handler(&callback1);
+    opt2->add_updated_handler(&callback2);
+
+    begin_notification_batch();
+    opt1->set_value(5);
+    opt1->set_value(6);
+    begin_notification_batch();
+    opt2->set_value(7);
+    end_notification_batch();
+    CHECK(calls1 == 0);
+    CHECK(calls2 == 0);
+    end_notification_batch();
+
+    CHECK(calls1 == 1);
+    CHECK(calls2 == 1);
+    CHECK(seen_opt2 == 7); // handlers see the whole batch applied
+
+    SUBCASE("Options destroyed during a batch are not notified")
+    {
+        auto temporary = std::make_shared<option_t<int>>("tmp", 1);
+        int calls = 0;
+        updated_callback_t callback = [&] () { ++calls; };
+        temporary->add_updated_handler(&callback);
+
+        begin_notification_batch();
+        temporary->set_value(2);
+        opt2->set_value(8);
+        temporary.reset();
+        end_notification_batch();
+        CHECK(calls == 0);
+        CHECK(calls2 == 2);
+    }
+
+    SUBCASE("Options destroyed on another thread during a batch are not notified")
+    {
+        auto temporary = std::make_shared<option_t<int>>("tmp", 1);
+        int calls = 0;
+        updated_callback_t callback = [&] () { ++calls; };
+        temporary->add_updated_handler(&callback);
+
+        begin_notification_batch();
+        temporary->set_value(2);
+        std::thread([&] { temporary.reset(); }).join();
+        end_notification_batch();
+        CHECK(calls == 0);
+    }
+
+    SUBCASE("Batches do not affect other threads")
+    {
+        begin_notification_batch();
+        std::thread([&] { opt2->set_value(8); }).join();
+        CHECK(calls2 == 2);
+        end_notification_batch();
+        CHECK(calls2 == 2);
+    }
+
+    SUBCASE("Changes made by handlers are delivered")
+    {
+        updated_callback_t chain = [&] () { opt2->set_value(opt1->get_value()); };
+        opt1->add_updated_handler(&chain);
+
+        begin_notification_batch();
+        opt1->set_value(9);
+        end_notification_batch();
+        CHECK(opt2->get_value() == 9);
+        CHECK(calls2 == 2);
+        opt1->rem_updated_handler(&chain);
+    }
+
+    SUBCASE("notification_batch_t ends the batch on exceptions")
+    {
+        try {
+            notification_batch_t batch;
+            opt2->set_value(10);
+            throw std::runtime_error("failed");
+        } catch (const std::runtime_error&)
+        {}
+
+        CHECK(calls2 == 2);
+        opt2->set_value(11);
+        CHECK(calls2 == 3);
+    }
+
+    SUBCASE("Exceptions from handlers do not stop the delivery")
+    {
+        updated_callback_t throwing = [&] () { throw std::runtime_error("failed"); };
+        opt1->add_updated_handler(&throwing);
+
+        begin_notification_batch();
+        opt1->set_value(10);
+        opt2->set_value(10);
+        CHECK_THROWS(end_notification_batch());
+        CHECK(calls2 == 2);
+
+        /* The batch destructor logs the exception instead */
+        {
+            notification_batch_t batch;
+            opt1->set_value(11);
+            opt2->set_value(11);
+        }
+
+        CHECK(calls2 == 3);
+        opt1->rem_updated_handler(&throwing);
+
+        /* Notifications are delivered directly again */
+        opt2->set_value(12);
+        CHECK(calls2 == 4);
+    }
+}
+
 TEST_CASE("compound options")
 {
     using namespace wf;
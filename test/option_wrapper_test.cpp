@@ -63,6 +63,15 @@ TEST_CASE("wf::base_option_wrapper_t")
     opt->set_value(6);
     CHECK(updated);
 
+    /* Values of simple options are not copied */
+    auto sopt = std::make_shared<option_t<std::string>>("Option3", "value");
+    section->register_new_option(sopt);
+    wrapper_t<std::string> wrapper3{"Test/Option3"};
+    const std::string& value_ref = wrapper3;
+    CHECK(&value_ref == &sopt->get_value());
+    CHECK(&wrapper3.value() == &sopt->get_value());
+    CHECK(wrapper3.value() == "value");
+
     /* Check move operations */
     wrapper_t<int> wrapper1{"Test/Option1"};
     CHECK((option_sptr_t<int>)wrapper1 == opt);
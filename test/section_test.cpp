@@ -46,3 +46,54 @@ TEST_CASE("wf::config::section_t")
     CHECK(clone->get_option_or(
         "IntOption")->get_value_str() == intopt->get_value_str());
 }
+
+TEST_CASE("wf::config::section_t - options are stored sorted by name")
+{
+    using namespace wf::config;
+
+    section_t section{"Test"};
+    std::vector<std::string> names = {"m", "b", "z", "a", "mm", "c"};
+    for (auto& name : names)
+    {
+        section.register_new_option(std::make_shared<option_t<int>>(name, 0));
+    }
+
+    auto b = section.get_option("b");
+    section.unregister_option(section.get_option("m"));
+    section.register_new_option(std::make_shared<option_t<int>>("b", 1));
+
+    std::vector<std::string> stored;
+    for (auto& [name, option] : section.priv->options)
+    {
+        CHECK(option->get_name() == name);
+        stored.push_back(name);
+    }
+
+    CHECK(stored == std::vector<std::string>{"a", "b", "c", "mm", "z"});
+    CHECK(section.get_option_or("m") == nullptr);
+    CHECK(section.get_option("b") != b);
+    for (auto& name : stored)
+    {
+        CHECK(section.get_option_or(name) != nullptr);
+    }
+}
+
+TEST_CASE("wf::config::section_t::for_each_option")
+{
+    using namespace wf::config;
+
+    section_t section{"Test"};
+    auto a = std::make_shared<option_t<int>>("a", 0);
+    auto b = std::make_shared<option_t<int>>("b", 0);
+    section.register_new_option(b);
+    section.register_new_option(a);
+
+    std::vector<std::shared_ptr<option_base_t>> visited;
+    section.for_each_option([&] (const std::shared_ptr<option_base_t>& option)
+    {
+        visited.push_back(option);
+    });
+
+    CHECK(visited == section.get_registered_options());
+    CHECK(visited == std::vector<std::shared_ptr<option_base_t>>{a, b});
+}
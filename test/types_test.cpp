@@ -4,8 +4,11 @@
 
 #include <wayfire/config/types.hpp>
 #include <linux/input-event-codes.h>
+#include <libevdev/libevdev.h>
 #include <limits>
 
+#include "../src/evdev-names.hpp"
+
 #define WF_CONFIG_DOUBLE_EPS 0.01
 
 using namespace wf;
@@ -121,6 +124,35 @@ TEST_CASE("wf::color_t")
     CHECK(to_string<color_t>(color_t{1, 1, 1, 1}) == "#FFFFFFFF");
 }
 
+TEST_CASE("wf::config::evdev_names_t")
+{
+    using namespace wf::config;
+
+    auto& names  = evdev_names_t::get();
+    int max_code = libevdev_event_type_get_max(EV_KEY);
+    int named    = 0;
+    for (int code = 0; code <= max_code; code++)
+    {
+        auto name = libevdev_event_code_get_name(EV_KEY, code);
+        CHECK(names.name_from_code(code) == name);
+        if (name)
+        {
+            ++named;
+            CHECK(names.code_from_name(name) == code);
+        }
+    }
+
+    CHECK(named > 0);
+    CHECK(names.name_from_code(max_code + 1) == nullptr);
+    CHECK(names.code_from_name("KEY_E") == KEY_E);
+    CHECK(names.code_from_name("BTN_LEFT") == BTN_LEFT);
+    CHECK(names.code_from_name("BTN_MISC") ==
+        libevdev_event_code_from_name(EV_KEY, "BTN_MISC"));
+    CHECK(names.code_from_name("KEY_NOT_A_KEY") == -1);
+    CHECK(names.code_from_name("super") == -1);
+    CHECK(names.code_from_name("") == -1);
+}
+
 TEST_CASE("wf::keybinding_t")
 {
     /* Test simple constructor */
@@ -0,0 +1,154 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <poll.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <wayfire/config/update-dispatcher.hpp>
+#include <wayfire/config/option.hpp>
+
+static bool is_readable(int fd)
+{
+    pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+TEST_CASE("wf::config::update_dispatcher_t")
+{
+    using namespace wf::config;
+
+    update_dispatcher_t dispatcher;
+    REQUIRE(dispatcher.get_fd() >= 0);
+    CHECK(!is_readable(dispatcher.get_fd()));
+
+    std::vector<int> order;
+    dispatcher.post([&] () { order.push_back(1); });
+    dispatcher.post([&] ()
+    {
+        order.push_back(2);
+        dispatcher.post([&] () { order.push_back(3); });
+    });
+
+    CHECK(is_readable(dispatcher.get_fd()));
+    CHECK(order.empty());
+
+    dispatcher.dispatch();
+    CHECK(order == std::vector<int>{1, 2});
+    CHECK(is_readable(dispatcher.get_fd()));
+
+    dispatcher.dispatch();
+    CHECK(order == std::vector<int>{1, 2, 3});
+    CHECK(!is_readable(dispatcher.get_fd()));
+
+    /* Posting from multiple threads */
+    int called = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&] ()
+        {
+            for (int j = 0; j < 1000; j++)
+            {
+                dispatcher.post([&] () { ++called; });
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    dispatcher.dispatch();
+    CHECK(called == 4000);
+}
+
+TEST_CASE("wf::config::option_base_t dispatched handlers")
+{
+    using namespace wf::config;
+
+    update_dispatcher_t dispatcher;
+    option_t<int> opt{"test", 0};
+
+    std::thread::id handler_thread;
+    int called = 0;
+    option_base_t::updated_callback_t callback = [&] ()
+    {
+        handler_thread = std::this_thread::get_id();
+        ++called;
+    };
+    opt.add_updated_handler(&callback, dispatcher);
+
+    /* Updates from another thread are delivered on the dispatching thread, and
+     * are coalesced until the handler runs. */
+    std::thread worker([&] ()
+    {
+        opt.set_value(1);
+        opt.set_value(2);
+    });
+    worker.join();
+
+    CHECK(called == 0);
+    dispatcher.dispatch();
+    CHECK(called == 1);
+    CHECK(handler_thread == std::this_thread::get_id());
+    CHECK(opt.get_value() == 2);
+
+    opt.set_value(3);
+    dispatcher.dispatch();
+    CHECK(called == 2);
+
+    /* Handlers removed before dispatching are not run */
+    opt.set_value(4);
+    opt.rem_updated_handler(&callback);
+    dispatcher.dispatch();
+    CHECK(called == 2);
+
+    opt.set_value(5);
+    dispatcher.dispatch();
+    CHECK(called == 2);
+}
+
+TEST_CASE("wf::config::option_base_t dispatched handlers with a busy worker")
+{
+    using namespace wf::config;
+
+    update_dispatcher_t dispatcher;
+    option_t<int> opt{"test", 0};
+    opt.enable_concurrent_reads();
+
+    /* The handlers run while the worker keeps changing the value, so they
+     * read it with get_value_concurrent(). */
+    int last_seen = 0;
+    bool monotonic = true;
+    option_base_t::updated_callback_t callback = [&] ()
+    {
+        int value = opt.get_value_concurrent();
+        monotonic &= (value >= last_seen);
+        last_seen  = value;
+    };
+    opt.add_updated_handler(&callback, dispatcher);
+
+    std::atomic<bool> done{false};
+    std::thread worker([&] ()
+    {
+        for (int i = 1; i <= 10000; i++)
+        {
+            opt.set_value(i);
+        }
+
+        done = true;
+    });
+
+    while (!done)
+    {
+        dispatcher.dispatch();
+    }
+
+    worker.join();
+    dispatcher.dispatch();
+    CHECK(monotonic);
+    CHECK(last_seen == 10000);
+    opt.rem_updated_handler(&callback);
+}
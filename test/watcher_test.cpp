@@ -0,0 +1,124 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <fstream>
+
+#include <wayfire/config/watcher.hpp>
+#include <wayfire/config/types.hpp>
+
+static void write_file(const std::string& file, const std::string& contents)
+{
+    std::ofstream out{file, std::ios::trunc};
+    out << contents;
+}
+
+/**
+ * Dispatch events on the watcher until @condition is satisfied or the timeout
+ * expires.
+ */
+template<class Condition>
+static bool dispatch_until(wf::config::config_watcher_t& watcher,
+    Condition condition, int timeout_ms = 1000)
+{
+    while (!condition() && (timeout_ms > 0))
+    {
+        pollfd pfd = {watcher.get_fd(), POLLIN, 0};
+        poll(&pfd, 1, 10);
+        watcher.dispatch();
+        timeout_ms -= 10;
+    }
+
+    return condition();
+}
+
+TEST_CASE("wf::config::config_watcher_t")
+{
+    using namespace wf;
+    using namespace wf::config;
+
+    char dir_template[] = "/tmp/wf-config-watcher-XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    std::string userconf = dir + "/wayfire.ini";
+    std::string sysconf  = dir + "/defaults.ini";
+    write_file(userconf, "[section]\nopt = 1\n");
+    write_file(sysconf, "[section]\nopt = 0\nother = 5\n");
+
+    config_manager_t config;
+    auto section = std::make_shared<section_t>("section");
+    section->register_new_option(std::make_shared<option_t<int>>("opt", 0));
+    section->register_new_option(std::make_shared<option_t<int>>("other", 0));
+    config.merge_section(section);
+    load_configuration_options_from_file(config, userconf);
+    auto opt   = config.get_option<int>("section/opt");
+    auto other = config.get_option<int>("section/other");
+    REQUIRE(opt->get_value() == 1);
+
+    config_watcher_t watcher{config, {dir}, sysconf, userconf, 20};
+    REQUIRE(watcher.get_fd() >= 0);
+
+    int reloads = 0;
+    uint32_t last_changed_files = 0;
+    std::vector<std::string> last_changed;
+    watcher.set_reload_callback([&] (uint32_t changed_files,
+                                     const config_change_set_t& changes)
+    {
+        ++reloads;
+        last_changed_files = changed_files;
+        last_changed.clear();
+        for (auto& entry : changes.changed)
+        {
+            last_changed.push_back(entry.option->get_name());
+        }
+    });
+
+    SUBCASE("Bursts of writes are debounced")
+    {
+        write_file(userconf, "[section]\nopt = 2\n");
+        write_file(userconf, "[section]\nopt = 3\n");
+        write_file(userconf, "[section]\nopt = 4\n");
+        CHECK(dispatch_until(watcher, [&] { return reloads > 0; }));
+        CHECK(reloads == 1);
+        CHECK(opt->get_value() == 4);
+        CHECK(last_changed_files == config_watcher_t::WATCH_USERCONF);
+        CHECK(last_changed == std::vector<std::string>{"opt"});
+    }
+
+    SUBCASE("Reload waits for the writer to release the lock")
+    {
+        int fd = open(userconf.c_str(), O_RDONLY);
+        flock(fd, LOCK_EX);
+        write_file(userconf, "[section]\nopt = 2\n");
+        CHECK(!dispatch_until(watcher, [&] { return reloads > 0; }, 200));
+        CHECK(opt->get_value() == 1);
+
+        flock(fd, LOCK_UN);
+        close(fd);
+        CHECK(dispatch_until(watcher, [&] { return reloads > 0; }));
+        CHECK(opt->get_value() == 2);
+    }
+
+    SUBCASE("System config changes apply new defaults")
+    {
+        write_file(sysconf, "[section]\nopt = 0\nother = 6\n");
+        CHECK(dispatch_until(watcher, [&] { return reloads > 0; }));
+        CHECK(last_changed_files ==
+            (config_watcher_t::WATCH_SYSCONF | config_watcher_t::WATCH_USERCONF));
+        CHECK(other->get_value() == 6);
+        CHECK(opt->get_value() == 1);
+    }
+
+    SUBCASE("XML changes are reported")
+    {
+        write_file(dir + "/plugin.xml", "<wayfire></wayfire>");
+        CHECK(dispatch_until(watcher, [&] { return reloads > 0; }));
+        CHECK(last_changed_files == config_watcher_t::WATCH_XML);
+    }
+
+    unlink((dir + "/plugin.xml").c_str());
+    unlink(userconf.c_str());
+    unlink(sysconf.c_str());
+    rmdir(dir.c_str());
+}
@@ -6,8 +6,13 @@
 #include <wayfire/config/types.hpp>
 #include <wayfire/config/compound-option.hpp>
 #include <wayfire/config/xml.hpp>
+#include <wayfire/config/type-registry.hpp>
 #include <wayfire/util/log.hpp>
 #include <linux/input-event-codes.h>
+#include <fstream>
+#include <unistd.h>
+
+#include "../src/xml-impl.hpp"
 
 static const std::string xml_option_int =
     R"(
@@ -427,6 +432,23 @@ TEST_CASE("wf::config::xml::create_section")
             "OutputModeOption", "OutputPositionOption"};
         CHECK(opt_names == expected_names);
         CHECK(wxml::get_section_xml_node(section) == section_root);
+
+        auto metadata = wxml::get_section_metadata(section);
+        REQUIRE(metadata != nullptr);
+        CHECK(metadata->name == "plugin");
+        CHECK(metadata->get_attribute("name") == "TestPluginFull");
+        CHECK(metadata->text.empty());
+        REQUIRE(metadata->get_child("group") != nullptr);
+        CHECK(metadata->get_child("group")->children.size() == 4);
+
+        auto option_metadata =
+            wxml::get_option_metadata(section->get_option("StringOption"));
+        REQUIRE(option_metadata != nullptr);
+        CHECK(option_metadata->get_attribute("type") == "string");
+        CHECK(option_metadata->get_child("default")->text == "test");
+        CHECK(option_metadata->get_child("min") == nullptr);
+        CHECK(option_metadata.get() ==
+            &metadata->get_child("group")->get_child("subgroup")->children[0]);
     }
 
     SUBCASE("Missing section name")
@@ -443,3 +465,344 @@ TEST_CASE("wf::config::xml::create_section")
         EXPECT_LINE(log, "is not a plugin/object element");
     }
 }
+
+/* ------------------------- option type registry -------------------------- */
+namespace
+{
+/** A custom option type, as an application could define it. */
+struct direction_t
+{
+    bool horizontal;
+    bool operator ==(const direction_t& other) const
+    {
+        return horizontal == other.horizontal;
+    }
+};
+}
+
+namespace wf
+{
+namespace option_type
+{
+template<>
+std::optional<direction_t> from_string(const std::string& value)
+{
+    if ((value == "horizontal") || (value == "vertical"))
+    {
+        return direction_t{value == "horizontal"};
+    }
+
+    return {};
+}
+
+template<>
+std::string to_string(const direction_t& value)
+{
+    return value.horizontal ? "horizontal" : "vertical";
+}
+}
+}
+
+TEST_CASE("wf::config::register_option_type")
+{
+    namespace wxml = wf::config::xml;
+    namespace wc   = wf::config;
+
+    std::stringstream log;
+    wf::log::initialize_logging(log,
+        wf::log::LOG_LEVEL_DEBUG, wf::log::LOG_COLOR_MODE_OFF);
+
+    auto create_option = [&] (std::string source)
+    {
+        auto node = xmlParseDoc((const xmlChar*)source.c_str());
+        REQUIRE(node != nullptr);
+        return wxml::create_option_from_xml_node(xmlDocGetRootElement(node));
+    };
+
+    const std::string direction_option = R"(
+<option name="Direction" type="direction">
+<default>vertical</default>
+</option>)";
+
+    const std::string direction_list = R"(
+<option name="Directions" type="dynamic-list">
+<entry prefix="dir_" type="direction"/>
+<entry prefix="mode_" type="output::mode"/>
+</option>)";
+
+    CHECK(wc::find_option_type("int") != nullptr);
+    CHECK(wc::find_option_type("int")->set_minimum);
+    CHECK(!wc::find_option_type("bool")->set_minimum);
+    CHECK(create_option(direction_option) == nullptr);
+    EXPECT_LINE(log, "has invalid type \"direction\"");
+
+    wc::register_option_type<direction_t>("direction");
+    REQUIRE(wc::find_option_type("direction") != nullptr);
+
+    auto option = std::dynamic_pointer_cast<wc::option_t<direction_t>>(
+        create_option(direction_option));
+    REQUIRE(option != nullptr);
+    CHECK(option->get_value() == direction_t{false});
+    CHECK(option->set_value_str("horizontal"));
+    CHECK(option->get_value_str() == "horizontal");
+
+    auto list = std::dynamic_pointer_cast<wc::compound_option_t>(
+        create_option(direction_list));
+    REQUIRE(list != nullptr);
+    REQUIRE(list->get_entries().size() == 2);
+    CHECK(dynamic_cast<wc::compound_option_entry_t<direction_t>*>(
+        list->get_entries()[0].get()));
+    CHECK(dynamic_cast<wc::compound_option_entry_t<wf::output_config::mode_t>*>(
+        list->get_entries()[1].get()));
+
+    /* Types can be replaced, for example to remove the support for bounds */
+    auto info = wc::make_option_type_info<int>();
+    info.set_minimum = nullptr;
+    wc::register_option_type("int", info);
+    EXPECT_LINE(log, "Replacing built-in option type \"int\"");
+    auto bounded = create_option(xml_option_int);
+    REQUIRE(bounded != nullptr);
+    CHECK(std::dynamic_pointer_cast<wc::option_t<int>>(bounded)->get_minimum() ==
+        std::nullopt);
+    wc::register_option_type<int>("int");
+
+    wc::register_option_type<direction_t>("dynamic-list");
+    EXPECT_LINE(log, "the name is reserved");
+    CHECK(wc::find_option_type("dynamic-list") == nullptr);
+}
+
+/* ------------------------ read_section_schemas test ----------------------- */
+static const std::string xml_edge_cases =
+    R"(
+<plugin name="TestPluginEdgeCases">
+    <option name="CommentInDefault" type="int">
+        <default><!-- not a value -->3</default>
+    </option>
+    <option name="LastDefaultWins" type="int">
+        <default>1</default>
+        <default>2</default>
+        <default><b>3</b></default>
+    </option>
+    <option name="EmptyElements" type="string">
+        <default/>
+        <min></min>
+    </option>
+    <option name="CData" type="string">
+        <default><![CDATA[not a text node]]></default>
+    </option>
+    <group><subgroup><group>
+        <option name="Nested" type="int"><default>5</default></option>
+    </group></subgroup></group>
+    <unknown>
+        <option name="NotAnOption" type="int"><default>5</default></option>
+    </unknown>
+    <option name="BadEntry" type="dynamic-list">
+        <entry prefix="a" type="int"/>
+        <entry type="int"/>
+    </option>
+    <option name="HintedList" type="dynamic-list" type-hint="plain">
+        <entry prefix="b" type="string" name="value"><default>x &amp; y</default></entry>
+        <default>ignored</default>
+    </option>
+</plugin>
+)";
+
+static void check_same_metadata(const wf::config::xml::metadata_node_t& a,
+    const wf::config::xml::metadata_node_t& b)
+{
+    CHECK(a.name == b.name);
+    CHECK(a.attributes == b.attributes);
+    CHECK(a.text == b.text);
+    REQUIRE(a.children.size() == b.children.size());
+    for (size_t i = 0; i < a.children.size(); i++)
+    {
+        check_same_metadata(a.children[i], b.children[i]);
+    }
+}
+
+static void check_same_schema(const wf::config::xml::section_schema_t& a,
+    const wf::config::xml::section_schema_t& b)
+{
+    CHECK(a.name == b.name);
+    REQUIRE(a.metadata);
+    REQUIRE(b.metadata);
+    check_same_metadata(*a.metadata, *b.metadata);
+    REQUIRE(a.options.size() == b.options.size());
+    for (size_t i = 0; i < a.options.size(); i++)
+    {
+        auto& opt_a = a.options[i];
+        auto& opt_b = b.options[i];
+        CHECK(opt_a.name == opt_b.name);
+        CHECK(opt_a.type == opt_b.type);
+        CHECK(opt_a.default_value == opt_b.default_value);
+        CHECK(opt_a.min == opt_b.min);
+        CHECK(opt_a.max == opt_b.max);
+        CHECK(opt_a.type_hint == opt_b.type_hint);
+        CHECK(opt_a.line == opt_b.line);
+        REQUIRE(opt_a.entries.size() == opt_b.entries.size());
+        for (size_t j = 0; j < opt_a.entries.size(); j++)
+        {
+            CHECK(opt_a.entries[j].prefix == opt_b.entries[j].prefix);
+            CHECK(opt_a.entries[j].type == opt_b.entries[j].type);
+            CHECK(opt_a.entries[j].name == opt_b.entries[j].name);
+            CHECK(opt_a.entries[j].default_value == opt_b.entries[j].default_value);
+            CHECK(opt_a.entries[j].line == opt_b.entries[j].line);
+        }
+
+        /* The option metadata must point into the section metadata */
+        REQUIRE(opt_b.metadata);
+        check_same_metadata(*opt_a.metadata, *opt_b.metadata);
+        CHECK(opt_b.metadata.owner_before(b.metadata) == false);
+        CHECK(b.metadata.owner_before(opt_b.metadata) == false);
+    }
+}
+
+/** Remove the timestamp and source location from each line of the log. */
+static std::string strip_log_prefixes(const std::string& log)
+{
+    std::istringstream in{log};
+    std::string result, line;
+    while (std::getline(in, line))
+    {
+        result += line.substr(line.find("] ") + 1) + "\n";
+    }
+
+    return result;
+}
+
+TEST_CASE("wf::config::xml::read_section_schemas")
+{
+    namespace wxml = wf::config::xml;
+
+    std::stringstream log;
+    wf::log::initialize_logging(log,
+        wf::log::LOG_LEVEL_DEBUG, wf::log::LOG_COLOR_MODE_OFF);
+
+    char file_template[] = "/tmp/wf-config-xml-XXXXXX";
+    int fd = mkstemp(file_template);
+    REQUIRE(fd >= 0);
+    close(fd);
+    std::string file = file_template;
+
+    auto write_document = [&] (const std::string& contents)
+    {
+        std::ofstream out{file, std::ios::trunc};
+        out << "<?xml version=\"1.0\"?>\n<wayfire>" << contents << "</wayfire>\n";
+    };
+
+    auto read_dom = [&] ()
+    {
+        std::vector<wxml::section_schema_t> result;
+        auto doc = xmlParseFile(file.c_str());
+        REQUIRE(doc != nullptr);
+        auto node = xmlDocGetRootElement(doc)->children;
+        for (; node != nullptr; node = node->next)
+        {
+            if ((node->type == XML_ELEMENT_NODE) &&
+                (((const char*)node->name == std::string{"plugin"}) ||
+                 ((const char*)node->name == std::string{"object"})))
+            {
+                if (auto schema = wxml::extract_section_schema(node))
+                {
+                    result.push_back(std::move(*schema));
+                }
+            }
+        }
+
+        return result;
+    };
+
+    auto read_stream = [&] ()
+    {
+        std::vector<wxml::section_schema_t> result;
+        CHECK(wxml::read_section_schemas(file, [&] (wxml::section_schema_t&& schema)
+        {
+            CHECK(schema.xml == nullptr);
+            result.push_back(std::move(schema));
+        }));
+        return result;
+    };
+
+    auto check_same_result = [&] (const std::string& contents)
+    {
+        write_document(contents);
+        auto dom     = read_dom();
+        auto dom_log = log.str();
+        log.str("");
+
+        auto stream = read_stream();
+        CHECK(strip_log_prefixes(log.str()) == strip_log_prefixes(dom_log));
+        REQUIRE(dom.size() == stream.size());
+        for (size_t i = 0; i < dom.size(); i++)
+        {
+            check_same_schema(dom[i], stream[i]);
+
+            auto dom_section    = wxml::create_section_from_schema(dom[i], file);
+            auto stream_section = wxml::create_section_from_schema(stream[i], file);
+            auto dom_options    = dom_section->get_registered_options();
+            auto stream_options = stream_section->get_registered_options();
+            REQUIRE(dom_options.size() == stream_options.size());
+            for (size_t j = 0; j < dom_options.size(); j++)
+            {
+                CHECK(dom_options[j]->get_name() == stream_options[j]->get_name());
+                CHECK(dom_options[j]->get_default_value_str() ==
+                    stream_options[j]->get_default_value_str());
+                CHECK(typeid(*dom_options[j]) == typeid(*stream_options[j]));
+            }
+        }
+    };
+
+    SUBCASE("Full section")
+    {
+        check_same_result(xml_section_full + xml_section_empty + xml_section_no_plugins);
+    }
+
+    SUBCASE("Options")
+    {
+        check_same_result("<plugin name=\"Options\">" + xml_option_int +
+            xml_option_string + xml_option_key + xml_option_dyn_list +
+            xml_option_dyn_list_default + xml_option_bad_type + xml_option_bad_default +
+            xml_option_int_bad_min + xml_option_missing_name + xml_option_missing_type +
+            xml_option_missing_default_value + xml_option_dyn_list_no_prefix +
+            xml_option_dyn_list_no_type + "</plugin>");
+        CHECK(log.str().find("missing \"name\" attribute") != std::string::npos);
+    }
+
+    SUBCASE("Edge cases")
+    {
+        check_same_result(xml_edge_cases);
+        auto stream = read_stream();
+        REQUIRE(stream.size() == 1);
+        std::map<std::string, wxml::option_schema_t> options;
+        for (auto& option : stream[0].options)
+        {
+            options[option.name] = option;
+        }
+
+        CHECK(options.count("CommentInDefault") == 0);
+        CHECK(options["LastDefaultWins"].default_value == "2");
+        CHECK(options["EmptyElements"].default_value == "");
+        CHECK(options["EmptyElements"].min == "");
+        CHECK(options.count("CData") == 0);
+        CHECK(options["Nested"].default_value == "5");
+        CHECK(options.count("NotAnOption") == 0);
+        CHECK(options.count("BadEntry") == 0);
+        CHECK(options["HintedList"].type_hint == "plain");
+        CHECK(options["HintedList"].entries[0].default_value == "x & y");
+    }
+
+    SUBCASE("Sections without name and objects")
+    {
+        check_same_result(xml_section_missing_name + xml_section_bad_tag +
+            "<object name=\"obj\"><option name=\"o\" type=\"int\">"
+            "<default>1</default></option></object>");
+    }
+
+    SUBCASE("Malformed file")
+    {
+        write_document("<plugin name=\"a\"></plugin><plugin name=\"b\">");
+        CHECK(!wxml::read_section_schemas(file, [] (wxml::section_schema_t&&) {}));
+    }
+
+    unlink(file.c_str());
+}